@@ -1,57 +1,16 @@
 #include <iostream>
 #include <string>
 #include <vector>
+#include "HexCodec.h"
 using namespace std;
 
 // Utility functions for conversion and validation
 string hexToBinary(string hex) {
-    string binary = "";
-    for (char c : hex) {
-        switch(toupper(c)) {
-            case '0': binary += "0000"; break;
-            case '1': binary += "0001"; break;
-            case '2': binary += "0010"; break;
-            case '3': binary += "0011"; break;
-            case '4': binary += "0100"; break;
-            case '5': binary += "0101"; break;
-            case '6': binary += "0110"; break;
-            case '7': binary += "0111"; break;
-            case '8': binary += "1000"; break;
-            case '9': binary += "1001"; break;
-            case 'A': binary += "1010"; break;
-            case 'B': binary += "1011"; break;
-            case 'C': binary += "1100"; break;
-            case 'D': binary += "1101"; break;
-            case 'E': binary += "1110"; break;
-            case 'F': binary += "1111"; break;
-            default: throw invalid_argument("Invalid hexadecimal digit");
-        }
-    }
-    return binary;
+    return hexToBitString(hex);
 }
 
 string binaryToHex(string binary) {
-    string hex = "";
-    for (int i = 0; i < binary.length(); i += 4) {
-        string chunk = binary.substr(i, 4);
-        if (chunk == "0000") hex += "0";
-        else if (chunk == "0001") hex += "1";
-        else if (chunk == "0010") hex += "2";
-        else if (chunk == "0011") hex += "3";
-        else if (chunk == "0100") hex += "4";
-        else if (chunk == "0101") hex += "5";
-        else if (chunk == "0110") hex += "6";
-        else if (chunk == "0111") hex += "7";
-        else if (chunk == "1000") hex += "8";
-        else if (chunk == "1001") hex += "9";
-        else if (chunk == "1010") hex += "A";
-        else if (chunk == "1011") hex += "B";
-        else if (chunk == "1100") hex += "C";
-        else if (chunk == "1101") hex += "D";
-        else if (chunk == "1110") hex += "E";
-        else if (chunk == "1111") hex += "F";
-    }
-    return hex;
+    return bitStringToHex(binary, true);
 }
 
 // S-DES Implementation
@@ -3,6 +3,7 @@
 #include <vector>
 #include <bitset>
 #include <iomanip>
+#include "HexCodec.h"
 using namespace std;
 
 // S-DES Constants
@@ -28,22 +29,11 @@ const int S1[4][4] = {
 
 // Utility Functions
 string toBinary(string hex) {
-    string binary;
-    for(char c : hex) {
-        int value = (c >= 'A') ? (c - 'A' + 10) : (c - '0');
-        binary += bitset<4>(value).to_string();
-    }
-    return binary;
+    return hexToBitString(hex);
 }
 
 string toHex(string binary) {
-    string hex;
-    for(size_t i = 0; i < binary.length(); i += 4) {
-        string chunk = binary.substr(i, 4);
-        int value = bitset<4>(chunk).to_ulong();
-        hex += (value < 10) ? ('0' + value) : ('A' + value - 10);
-    }
-    return hex;
+    return bitStringToHex(binary, true);
 }
 
 // S-DES Implementation
@@ -195,22 +185,11 @@ public:
 
     // Existing static conversion methods remain the same
     static string hexToBinary(const string& hex) {
-        stringstream binary;
-        for(char c : hex) {
-            int value = (c >= 'A') ? (c - 'A' + 10) : (c - '0');
-            binary << bitset<4>(value);
-        }
-        return binary.str();
+        return hexToBitString(hex);
     }
 
     static string binaryToHex(const string& binary) {
-        stringstream hex;
-        hex << std::hex << std::setfill('0');
-        for(size_t i = 0; i < binary.length(); i += 4) {
-            string chunk = binary.substr(i, 4);
-            hex << std::setw(1) << std::stoi(chunk, nullptr, 2);
-        }
-        return hex.str();
+        return bitStringToHex(binary);
     }
 };
 
@@ -330,11 +309,16 @@ int main() {
                 cin >> key;
 
                 // Convert hex to binary if needed
-                if(input.length() == 2) {
-                    input = toBinary(input);
-                }
-                if(key.length() == 3) {
-                    key = toBinary(key);
+                try {
+                    if(input.length() == 2) {
+                        input = toBinary(input);
+                    }
+                    if(key.length() == 3) {
+                        key = toBinary(key);
+                    }
+                } catch(const invalid_argument& e) {
+                    cout << "Invalid input: " << e.what() << endl;
+                    break;
                 }
 
                 // Validate input
@@ -342,6 +326,10 @@ int main() {
                     cout << "Invalid input length!\n";
                     break;
                 }
+                if(input.find_first_not_of("01") != string::npos || key.find_first_not_of("01") != string::npos) {
+                    cout << "Input and key must be binary digits!\n";
+                    break;
+                }
 
                 SDES sdes(key);
                 string result = (choice == 1) ? sdes.encrypt(input) : sdes.decrypt(input);
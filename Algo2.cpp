@@ -6,6 +6,20 @@
 #include <sstream>
 #include <stdexcept>
 #include <algorithm>
+#include <functional>
+#include <cstring>
+#include <cstdint>
+#include <chrono>
+#include <thread>
+#include <atomic>
+#include <limits>
+#include "HexCodec.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#include <cpuid.h>
+#define HAVE_X86_SIMD 1
+#endif
 
 using namespace std;
 
@@ -75,8 +89,12 @@ private:
     vector<vector<unsigned char>> state;
     vector<vector<unsigned char>> roundKeys;
     int Nr; // Number of rounds
+    bool verbose; // Print the state after every step
 
     void printState(const string& label) {
+        if (!verbose) {
+            return;
+        }
         cout << label << ":" << endl;
         for(const auto& row : state) {
             for(unsigned char byte : row) {
@@ -136,10 +154,42 @@ private:
         printState("After MixColumns");
     }
 
+    void invSubBytes() {
+        for(auto& row : state) {
+            transform(row.begin(), row.end(), row.begin(), 
+                [](unsigned char byte) { return INV_SBOX[byte]; });
+        }
+        printState("After InvSubBytes");
+    }
+
+    void invShiftRows() {
+        // Row r shifts right by r
+        rotate(state[1].begin(), state[1].begin() + 3, state[1].end());
+        rotate(state[2].begin(), state[2].begin() + 2, state[2].end());
+        rotate(state[3].begin(), state[3].begin() + 1, state[3].end());
+        printState("After InvShiftRows");
+    }
+
+    void invMixColumns() {
+        vector<vector<unsigned char>> temp = state;
+        for (int c = 0; c < 4; ++c) {
+            state[0][c] = gmul(temp[0][c], 14) ^ gmul(temp[1][c], 11) ^ 
+                          gmul(temp[2][c], 13) ^ gmul(temp[3][c], 9);
+            state[1][c] = gmul(temp[0][c], 9) ^ gmul(temp[1][c], 14) ^ 
+                          gmul(temp[2][c], 11) ^ gmul(temp[3][c], 13);
+            state[2][c] = gmul(temp[0][c], 13) ^ gmul(temp[1][c], 9) ^ 
+                          gmul(temp[2][c], 14) ^ gmul(temp[3][c], 11);
+            state[3][c] = gmul(temp[0][c], 11) ^ gmul(temp[1][c], 13) ^ 
+                          gmul(temp[2][c], 9) ^ gmul(temp[3][c], 14);
+        }
+        printState("After InvMixColumns");
+    }
+
     void addRoundKey(int round) {
+        // Round key word i is state column i
         for(int i = 0; i < 4; ++i) {
             for(int j = 0; j < 4; ++j) {
-                state[i][j] ^= roundKeys[round*4 + i][j];
+                state[j][i] ^= roundKeys[round*4 + i][j];
             }
         }
         printState("After AddRoundKey");
@@ -164,7 +214,8 @@ private:
                     transform(roundKey.begin(), roundKey.end(), roundKey.begin(), 
                         [](unsigned char byte) { return SBOX[byte]; });
                     // XOR with round constant
-                    roundKey[0] ^= (1 << ((i/4 - 1) % 10));
+                    static const unsigned char RCON[10] = {0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, 0x80, 0x1b, 0x36};
+                    roundKey[0] ^= RCON[i/4 - 1];
                 }
                 
                 // XOR with previous round key
@@ -177,13 +228,20 @@ private:
     }
 
 public:
-    AES(const vector<unsigned char>& key) : Nr(10) {
+    // key must be 16 bytes; this class does AES-128 only
+    AES(const vector<unsigned char>& key, bool verbose = true) : Nr(10), verbose(verbose) {
+        if (key.size() != 16) {
+            throw invalid_argument("AES key must be 128 bits");
+        }
         // Initialize state and perform key expansion
         state = vector<vector<unsigned char>>(4, vector<unsigned char>(4));
         keyExpansion(key);
     }
 
     vector<unsigned char> encrypt(const vector<unsigned char>& plaintext) {
+        if (plaintext.size() != 16) {
+            throw invalid_argument("AES block must be 128 bits");
+        }
         // Initialize state from plaintext
         for(int i = 0; i < 4; ++i) {
             for(int j = 0; j < 4; ++j) {
@@ -197,7 +255,9 @@ public:
 
         // Main rounds
         for(int round = 1; round < Nr; ++round) {
-            cout<< "\nRound " << round << ":" << endl;
+            if (verbose) {
+                cout<< "\nRound " << round << ":" << endl;
+            }
             subBytes();
             shiftRows();
             mixColumns();
@@ -219,25 +279,865 @@ public:
         return ciphertext;
     }
 
+    // Inverse cipher (FIPS-197 section 5.3): the rounds run backwards with
+    // the inverse steps
+    vector<unsigned char> decrypt(const vector<unsigned char>& ciphertext) {
+        if (ciphertext.size() != 16) {
+            throw invalid_argument("AES block must be 128 bits");
+        }
+        for(int i = 0; i < 4; ++i) {
+            for(int j = 0; j < 4; ++j) {
+                state[j][i] = ciphertext[i*4 + j];
+            }
+        }
+        printState("Initial State");
+
+        addRoundKey(Nr);
+
+        for(int round = Nr - 1; round > 0; --round) {
+            if (verbose) {
+                cout<< "\nRound " << round << ":" << endl;
+            }
+            invShiftRows();
+            invSubBytes();
+            addRoundKey(round);
+            invMixColumns();
+        }
+
+        invShiftRows();
+        invSubBytes();
+        addRoundKey(0);
+
+        vector<unsigned char> plaintext;
+        for(int i = 0; i < 4; ++i) {
+            for(int j = 0; j < 4; ++j) {
+                plaintext.push_back(state[j][i]);
+            }
+        }
+        return plaintext;
+    }
+
     // Helper method to convert hex string to bytes
     static vector<unsigned char> hexToBytes(const string& hex) {
-        vector<unsigned char> bytes;
-        for(size_t i = 0; i < hex.length(); i += 2) {
-            string byteString = hex.substr(i, 2);
-            unsigned char byte = stoi(byteString, nullptr, 16);
-            bytes.push_back(byte);
-        }
-        return bytes;
+        return hexDecode(hex);
     }
 
     // Helper method to convert bytes to hex string
     static string bytesToHex(const vector<unsigned char>& bytes) {
-        stringstream ss;
-        ss << hex << setfill('0');
-        for(unsigned char byte : bytes) {
-            ss << setw(2) << static_cast<int>(byte);
+        return hexEncode(bytes);
+    }
+};
+
+// T-tables for the fast AES engine. TE[0][x] is the MixColumns column of
+// S(x), (2S, S, S, 3S) packed big-endian; TE[1..3] are its byte rotations,
+// so one round of SubBytes, ShiftRows and MixColumns on a column is four
+// lookups and XORs. TD is the same for the inverse cipher:
+// (14S', 9S', 13S', 11S') with S' = INV_SBOX[x].
+struct AESTables {
+    uint32_t TE[4][256];
+    uint32_t TD[4][256];
+
+    static uint32_t mul(uint32_t a, uint32_t b) {
+        uint32_t result = 0;
+        for (; b; b >>= 1) {
+            if (b & 1) {
+                result ^= a;
+            }
+            a = (a << 1) ^ ((a & 0x80) ? 0x11b : 0);
+        }
+        return result;
+    }
+
+    AESTables() {
+        for (int x = 0; x < 256; x++) {
+            uint32_t s = SBOX[x];
+            uint32_t encrypt = (mul(s, 2) << 24) | (s << 16) | (s << 8) | mul(s, 3);
+            uint32_t i = INV_SBOX[x];
+            uint32_t decrypt = (mul(i, 14) << 24) | (mul(i, 9) << 16) | (mul(i, 13) << 8) | mul(i, 11);
+            for (int t = 0; t < 4; t++) {
+                TE[t][x] = encrypt;
+                TD[t][x] = decrypt;
+                encrypt = (encrypt >> 8) | (encrypt << 24);
+                decrypt = (decrypt >> 8) | (decrypt << 24);
+            }
+        }
+    }
+};
+
+const AESTables AES_TABLES;
+
+// FIPS-197 key expansion into big-endian words; returns the round count.
+// keyLength must be 16, 24 or 32 bytes. sbox does SubWord one byte at a
+// time, so the constant-time engine can avoid a secret-indexed table.
+int expandAESKey(const uint8_t* key, size_t keyLength, uint32_t roundKeys[60], uint8_t (*sbox)(uint8_t)) {
+    int nk = (int)keyLength / 4;
+    int rounds = nk + 6;
+    auto subWord = [sbox](uint32_t word) {
+        return ((uint32_t)sbox(word >> 24) << 24) | ((uint32_t)sbox((word >> 16) & 0xff) << 16)
+             | ((uint32_t)sbox((word >> 8) & 0xff) << 8) | sbox(word & 0xff);
+    };
+    for (int i = 0; i < nk; i++) {
+        roundKeys[i] = ((uint32_t)key[4 * i] << 24) | ((uint32_t)key[4 * i + 1] << 16) | ((uint32_t)key[4 * i + 2] << 8) | key[4 * i + 3];
+    }
+    uint32_t rcon = 0x01;
+    for (int i = nk; i < 4 * (rounds + 1); i++) {
+        uint32_t temp = roundKeys[i - 1];
+        if (i % nk == 0) {
+            temp = subWord((temp << 8) | (temp >> 24)) ^ (rcon << 24);
+            rcon = (rcon << 1) ^ ((rcon & 0x80) ? 0x11b : 0);
+        } else if (nk > 6 && i % nk == 4) {
+            temp = subWord(temp);
+        }
+        roundKeys[i] = roundKeys[i - nk] ^ temp;
+    }
+    return rounds;
+}
+
+#ifdef HAVE_X86_SIMD
+// AES-NI over independent blocks. keys holds the rounds + 1 round keys as
+// 16-byte blocks; for decryption they are the equivalent-inverse schedule
+// that AESDEC expects. Eight blocks are in flight at a time so the
+// AESENC/AESDEC latency of one block overlaps the others.
+template <bool Decrypt>
+__attribute__((target("aes,sse2")))
+static void aesBlocksAESNI(const uint8_t* keys, int rounds, const uint8_t* in, uint8_t* out, size_t blocks) {
+    __m128i rk[15];
+    for (int r = 0; r <= rounds; r++) {
+        rk[r] = _mm_loadu_si128((const __m128i*)(keys + 16 * r));
+    }
+
+    size_t i = 0;
+    for (; i + 8 <= blocks; i += 8) {
+        __m128i b[8];
+#pragma GCC unroll 8
+        for (int j = 0; j < 8; j++) {
+            b[j] = _mm_xor_si128(_mm_loadu_si128((const __m128i*)(in + (i + j) * 16)), rk[0]);
+        }
+        for (int r = 1; r < rounds; r++) {
+#pragma GCC unroll 8
+            for (int j = 0; j < 8; j++) {
+                b[j] = Decrypt ? _mm_aesdec_si128(b[j], rk[r]) : _mm_aesenc_si128(b[j], rk[r]);
+            }
+        }
+#pragma GCC unroll 8
+        for (int j = 0; j < 8; j++) {
+            b[j] = Decrypt ? _mm_aesdeclast_si128(b[j], rk[rounds]) : _mm_aesenclast_si128(b[j], rk[rounds]);
+            _mm_storeu_si128((__m128i*)(out + (i + j) * 16), b[j]);
+        }
+    }
+
+    for (; i < blocks; i++) {
+        __m128i b = _mm_xor_si128(_mm_loadu_si128((const __m128i*)(in + i * 16)), rk[0]);
+        for (int r = 1; r < rounds; r++) {
+            b = Decrypt ? _mm_aesdec_si128(b, rk[r]) : _mm_aesenc_si128(b, rk[r]);
+        }
+        b = Decrypt ? _mm_aesdeclast_si128(b, rk[rounds]) : _mm_aesenclast_si128(b, rk[rounds]);
+        _mm_storeu_si128((__m128i*)(out + i * 16), b);
+    }
+}
+#endif
+
+// CPU feature check, done once
+static bool cpuHasAESNI() {
+#ifdef HAVE_X86_SIMD
+    unsigned int eax, ebx, ecx, edx;
+    return __get_cpuid(1, &eax, &ebx, &ecx, &edx) && (ecx & bit_AES) && (edx & bit_SSE2);
+#else
+    return false;
+#endif
+}
+
+static bool cpuHasSSSE3() {
+#ifdef HAVE_X86_SIMD
+    unsigned int eax, ebx, ecx, edx;
+    return __get_cpuid(1, &eax, &ebx, &ecx, &edx) && (ecx & bit_SSSE3);
+#else
+    return false;
+#endif
+}
+
+// S-box lookup that touches every entry, for key schedules that must not
+// index a table with key bytes
+static uint8_t constantTimeSbox(uint8_t x) {
+    uint8_t result = 0;
+    for (int i = 0; i < 256; i++) {
+        uint8_t mask = (uint8_t)(0 - ((((unsigned)(i ^ x)) - 1) >> 8 & 1));
+        result |= SBOX[i] & mask;
+    }
+    return result;
+}
+
+#ifdef HAVE_X86_SIMD
+// Bitsliced AES (Kasper-Schwabe layout)
+// Eight blocks are transposed into eight registers: register k holds bit
+// 7 - k of every byte, and byte j of a register packs that bit of byte j
+// from all eight blocks. SubBytes becomes the Boyar-Peralta logic circuit
+// on whole registers, ShiftRows and the MixColumns row rotations become
+// fixed byte shuffles, and multiplication by x is a register renaming.
+// Nothing branches on or indexes memory by key or data, so the timing
+// does not depend on them. The __m128i operators below are GCC vector
+// extensions and compile to plain SSE2 logic instructions.
+
+static inline void swapMove(__m128i& a, __m128i& b, int shift, __m128i mask) {
+    __m128i t = _mm_and_si128(_mm_xor_si128(_mm_srli_epi64(b, shift), a), mask);
+    a = _mm_xor_si128(a, t);
+    b = _mm_xor_si128(b, _mm_slli_epi64(t, shift));
+}
+
+// 8x8 bit transpose at every byte position across the eight registers;
+// it is its own inverse
+static inline void bitsliceTranspose(__m128i q[8]) {
+    const __m128i m1 = _mm_set1_epi8(0x55), m2 = _mm_set1_epi8(0x33), m4 = _mm_set1_epi8(0x0f);
+    for (int i = 0; i < 8; i += 2) {
+        swapMove(q[i], q[i + 1], 1, m1);
+    }
+    for (int i : { 0, 1, 4, 5 }) {
+        swapMove(q[i], q[i + 2], 2, m2);
+    }
+    for (int i = 0; i < 4; i++) {
+        swapMove(q[i], q[i + 4], 4, m4);
+    }
+}
+
+// Boyar and Peralta, "A new combinational logic minimization technique
+// with applications to cryptology" (2009): 113 gates. x0 is the most
+// significant bit, matching the register order.
+static inline void bitslicedSubBytes(__m128i q[8]) {
+    __m128i x0 = q[0], x1 = q[1], x2 = q[2], x3 = q[3], x4 = q[4], x5 = q[5], x6 = q[6], x7 = q[7];
+
+    // Top linear transformation
+    __m128i y14 = x3 ^ x5, y13 = x0 ^ x6, y9 = x0 ^ x3, y8 = x0 ^ x5;
+    __m128i t0 = x1 ^ x2;
+    __m128i y1 = t0 ^ x7, y4 = y1 ^ x3, y12 = y13 ^ y14, y2 = y1 ^ x0;
+    __m128i y5 = y1 ^ x6, y3 = y5 ^ y8;
+    __m128i t1 = x4 ^ y12;
+    __m128i y15 = t1 ^ x5, y20 = t1 ^ x1, y6 = y15 ^ x7, y10 = y15 ^ t0;
+    __m128i y11 = y20 ^ y9, y7 = x7 ^ y11, y17 = y10 ^ y11, y19 = y10 ^ y8;
+    __m128i y16 = t0 ^ y11, y21 = y13 ^ y16, y18 = x0 ^ y16;
+
+    // Shared nonlinear section (inversion in GF(2^4)^2)
+    __m128i t2 = y12 & y15, t3 = y3 & y6, t4 = t3 ^ t2, t5 = y4 & x7;
+    __m128i t6 = t5 ^ t2, t7 = y13 & y16, t8 = y5 & y1, t9 = t8 ^ t7;
+    __m128i t10 = y2 & y7, t11 = t10 ^ t7, t12 = y9 & y11, t13 = y14 & y17;
+    __m128i t14 = t13 ^ t12, t15 = y8 & y10, t16 = t15 ^ t12, t17 = t4 ^ t14;
+    __m128i t18 = t6 ^ t16, t19 = t9 ^ t14, t20 = t11 ^ t16, t21 = t17 ^ y20;
+    __m128i t22 = t18 ^ y19, t23 = t19 ^ y21, t24 = t20 ^ y18;
+    __m128i t25 = t21 ^ t22, t26 = t21 & t23, t27 = t24 ^ t26, t28 = t25 & t27;
+    __m128i t29 = t28 ^ t22, t30 = t23 ^ t24, t31 = t22 ^ t26, t32 = t31 & t30;
+    __m128i t33 = t32 ^ t24, t34 = t23 ^ t33, t35 = t27 ^ t33, t36 = t24 & t35;
+    __m128i t37 = t36 ^ t34, t38 = t27 ^ t36, t39 = t29 & t38, t40 = t25 ^ t39;
+    __m128i t41 = t40 ^ t37, t42 = t29 ^ t33, t43 = t29 ^ t40, t44 = t33 ^ t37;
+    __m128i t45 = t42 ^ t41;
+    __m128i z0 = t44 & y15, z1 = t37 & y6, z2 = t33 & x7, z3 = t43 & y16;
+    __m128i z4 = t40 & y1, z5 = t29 & y7, z6 = t42 & y11, z7 = t45 & y17;
+    __m128i z8 = t41 & y10, z9 = t44 & y12, z10 = t37 & y3, z11 = t33 & y4;
+    __m128i z12 = t43 & y13, z13 = t40 & y5, z14 = t29 & y2, z15 = t42 & y9;
+    __m128i z16 = t45 & y14, z17 = t41 & y8;
+
+    // Bottom linear transformation
+    __m128i t46 = z15 ^ z16, t47 = z10 ^ z11, t48 = z5 ^ z13, t49 = z9 ^ z10;
+    __m128i t50 = z2 ^ z12, t51 = z2 ^ z5, t52 = z7 ^ z8, t53 = z0 ^ z3;
+    __m128i t54 = z6 ^ z7, t55 = z16 ^ z17, t56 = z12 ^ t48, t57 = t50 ^ t53;
+    __m128i t58 = z4 ^ t46, t59 = z3 ^ t54, t60 = t46 ^ t57, t61 = z14 ^ t57;
+    __m128i t62 = t52 ^ t58, t63 = t49 ^ t58, t64 = z4 ^ t59, t65 = t61 ^ t62;
+    __m128i t66 = z1 ^ t63, t67;
+    q[0] = t59 ^ t63;
+    q[6] = t56 ^ ~t62;
+    q[7] = t48 ^ ~t60;
+    t67 = t64 ^ t65;
+    q[3] = t53 ^ t66;
+    q[4] = t51 ^ t66;
+    q[5] = t47 ^ t65;
+    q[1] = t64 ^ ~q[3];
+    q[2] = t55 ^ ~t67;
+}
+
+// Byte j = 4 * column + row; ShiftRows moves row r left by r columns
+__attribute__((target("ssse3")))
+static inline void bitslicedShiftRows(__m128i q[8]) {
+    const __m128i shift = _mm_setr_epi8(0, 5, 10, 15, 4, 9, 14, 3, 8, 13, 2, 7, 12, 1, 6, 11);
+    for (int k = 0; k < 8; k++) {
+        q[k] = _mm_shuffle_epi8(q[k], shift);
+    }
+}
+
+// Column (a0..a3) becomes 2a_r ^ 3a_{r+1} ^ a_{r+2} ^ a_{r+3}, computed as
+// xtime(a ^ rot1(a)) ^ rot1(a) ^ rot2(a ^ rot1(a))
+__attribute__((target("ssse3")))
+static inline void bitslicedMixColumns(__m128i q[8]) {
+    const __m128i rot1 = _mm_setr_epi8(1, 2, 3, 0, 5, 6, 7, 4, 9, 10, 11, 8, 13, 14, 15, 12);
+    const __m128i rot2 = _mm_setr_epi8(2, 3, 0, 1, 6, 7, 4, 5, 10, 11, 8, 9, 14, 15, 12, 13);
+    __m128i a1[8], t[8];
+    for (int k = 0; k < 8; k++) {
+        a1[k] = _mm_shuffle_epi8(q[k], rot1);
+        t[k] = q[k] ^ a1[k];
+    }
+    // xtime on t: shift toward the high bit and reduce by x^4 + x^3 + x + 1
+    // where the old high bit (register 0) falls out
+    __m128i x[8] = { t[1], t[2], t[3], t[4] ^ t[0], t[5] ^ t[0], t[6], t[7] ^ t[0], t[0] };
+    for (int k = 0; k < 8; k++) {
+        q[k] = x[k] ^ a1[k] ^ _mm_shuffle_epi8(t[k], rot2);
+    }
+}
+
+static inline void bitslicedAddRoundKey(__m128i q[8], const __m128i* key) {
+    for (int k = 0; k < 8; k++) {
+        q[k] ^= _mm_load_si128(key + k);
+    }
+}
+
+// Eight blocks at in to out; keys holds 8 bitsliced registers per round key
+__attribute__((target("ssse3")))
+static void aesEncrypt8Bitsliced(const __m128i* keys, int rounds, const uint8_t* in, uint8_t* out) {
+    __m128i q[8];
+    for (int k = 0; k < 8; k++) {
+        q[k] = _mm_loadu_si128((const __m128i*)(in + 16 * k));
+    }
+    bitsliceTranspose(q);
+    bitslicedAddRoundKey(q, keys);
+    for (int round = 1; round < rounds; round++) {
+        bitslicedSubBytes(q);
+        bitslicedShiftRows(q);
+        bitslicedMixColumns(q);
+        bitslicedAddRoundKey(q, keys + 8 * round);
+    }
+    bitslicedSubBytes(q);
+    bitslicedShiftRows(q);
+    bitslicedAddRoundKey(q, keys + 8 * rounds);
+    bitsliceTranspose(q);
+    for (int k = 0; k < 8; k++) {
+        _mm_storeu_si128((__m128i*)(out + 16 * k), q[k]);
+    }
+}
+
+// Each round key replicated over the eight blocks and bitsliced: 8
+// registers per round key
+static void bitslicedKeySchedule(const uint32_t* words, int rounds, __m128i* keys) {
+    for (int round = 0; round <= rounds; round++) {
+        uint8_t bytes[16];
+        for (int c = 0; c < 4; c++) {
+            for (int b = 0; b < 4; b++) {
+                bytes[4 * c + b] = (uint8_t)(words[4 * round + c] >> (24 - 8 * b));
+            }
+        }
+        __m128i* q = keys + 8 * round;
+        for (int k = 0; k < 8; k++) {
+            q[k] = _mm_loadu_si128((const __m128i*)bytes);
         }
-        return ss.str();
+        bitsliceTranspose(q);
+    }
+}
+
+// Any number of blocks; a partial group is padded, which costs a full
+// group of work. in and out may be the same buffer.
+static void aesEncryptBlocksBitsliced(const __m128i* keys, int rounds, const uint8_t* in, uint8_t* out, size_t blocks) {
+    size_t i = 0;
+    for (; i + 8 <= blocks; i += 8) {
+        aesEncrypt8Bitsliced(keys, rounds, in + i * 16, out + i * 16);
+    }
+    if (i < blocks) {
+        uint8_t group[8 * 16] = { 0 };
+        memcpy(group, in + i * 16, (blocks - i) * 16);
+        aesEncrypt8Bitsliced(keys, rounds, group, group);
+        memcpy(out + i * 16, group, (blocks - i) * 16);
+    }
+}
+
+// Constant-time AES-128/192/256 for hosts without AES-NI; needs SSSE3.
+// FastAES encrypts through the same kernel on such hosts; this class keeps
+// a standalone engine with the FastAES block interface. Blocks are
+// processed eight at a time.
+class BitslicedAES {
+private:
+    __m128i keys[8 * 15]; // Round keys, each replicated over the 8 blocks and bitsliced
+    int rounds;
+
+public:
+    static const size_t BLOCK_SIZE = 16;
+    static const size_t PARALLEL_BLOCKS = 8;
+
+    static bool available() {
+        return cpuHasSSSE3();
+    }
+
+    BitslicedAES(const uint8_t* key, size_t keyLength) {
+        if (keyLength != 16 && keyLength != 24 && keyLength != 32) {
+            throw invalid_argument("AES key must be 128, 192 or 256 bits");
+        }
+        if (!available()) {
+            throw runtime_error("Bitsliced AES needs SSSE3");
+        }
+        uint32_t words[60];
+        rounds = expandAESKey(key, keyLength, words, constantTimeSbox);
+        bitslicedKeySchedule(words, rounds, keys);
+    }
+
+    explicit BitslicedAES(const vector<unsigned char>& key) : BitslicedAES(key.data(), key.size()) {}
+
+    int roundCount() const {
+        return rounds;
+    }
+
+    // Independent blocks (ECB); in and out may be the same buffer
+    void encryptBlocks(const uint8_t* in, uint8_t* out, size_t blocks) const {
+        aesEncryptBlocksBitsliced(keys, rounds, in, out, blocks);
+    }
+
+    void encryptBlock(const uint8_t in[16], uint8_t out[16]) const {
+        encryptBlocks(in, out, 1);
+    }
+
+    // One block, same shape as AES::encrypt
+    vector<unsigned char> encrypt(const vector<unsigned char>& plaintext) const {
+        if (plaintext.size() != BLOCK_SIZE) {
+            throw invalid_argument("AES block must be 128 bits");
+        }
+        vector<unsigned char> ciphertext(BLOCK_SIZE);
+        encryptBlock(plaintext.data(), ciphertext.data());
+        return ciphertext;
+    }
+};
+#endif
+
+
+// Production AES-128/192/256 (FIPS-197)
+// The portable path keeps the state in four 32-bit big-endian columns and
+// does each inner round with 16 T-table lookups. Decryption uses the
+// equivalent inverse cipher: InvMixColumns is applied to the middle round
+// keys once, so each inverse round is also 16 lookups, in the TD tables.
+// With AES-NI, the same two schedules are run through AESENC and AESDEC
+// instead. Without AES-NI but with SSSE3, encryption goes through the
+// constant-time bitsliced kernel, since T-table lookups leak the key
+// through the cache; decryption there stays on the TD tables. The backend
+// is picked once at startup. Blocks are independent, so one engine can be
+// shared between threads.
+class FastAES {
+private:
+    typedef void (*BlocksFunction)(const FastAES& aes, const uint8_t* in, uint8_t* out, size_t blocks);
+
+    uint32_t roundKeys[60]; // 4 * (rounds + 1) words
+    uint32_t decryptKeys[60]; // Equivalent-inverse schedule, in decryption order
+    uint8_t roundKeyBytes[240]; // The same keys in byte order, for AES-NI
+    uint8_t decryptKeyBytes[240];
+#ifdef HAVE_X86_SIMD
+    __m128i bitslicedKeys[8 * 15]; // Filled when the CPU has SSSE3
+#endif
+    int rounds;
+
+    static BlocksFunction selectBlocks(bool decrypt) {
+#ifdef HAVE_X86_SIMD
+        if (cpuHasAESNI()) {
+            return decrypt ? aesniDecryptBlocks : aesniBlocks;
+        }
+        if (!decrypt && cpuHasSSSE3()) {
+            return bitslicedBlocks;
+        }
+#endif
+        return decrypt ? portableDecryptBlocks : portableBlocks;
+    }
+
+    static BlocksFunction blocksFunction() {
+        static const BlocksFunction selected = selectBlocks(false);
+        return selected;
+    }
+
+    static BlocksFunction decryptFunction() {
+        static const BlocksFunction selected = selectBlocks(true);
+        return selected;
+    }
+
+    static void portableBlocks(const FastAES& aes, const uint8_t* in, uint8_t* out, size_t blocks) {
+        for (size_t i = 0; i < blocks; i++) {
+            aes.portableBlock(in + i * BLOCK_SIZE, out + i * BLOCK_SIZE);
+        }
+    }
+
+    static void portableDecryptBlocks(const FastAES& aes, const uint8_t* in, uint8_t* out, size_t blocks) {
+        for (size_t i = 0; i < blocks; i++) {
+            aes.portableDecryptBlock(in + i * BLOCK_SIZE, out + i * BLOCK_SIZE);
+        }
+    }
+
+#ifdef HAVE_X86_SIMD
+    static void aesniBlocks(const FastAES& aes, const uint8_t* in, uint8_t* out, size_t blocks) {
+        aesBlocksAESNI<false>(aes.roundKeyBytes, aes.rounds, in, out, blocks);
+    }
+
+    static void aesniDecryptBlocks(const FastAES& aes, const uint8_t* in, uint8_t* out, size_t blocks) {
+        aesBlocksAESNI<true>(aes.decryptKeyBytes, aes.rounds, in, out, blocks);
+    }
+
+    static void bitslicedBlocks(const FastAES& aes, const uint8_t* in, uint8_t* out, size_t blocks) {
+        aesEncryptBlocksBitsliced(aes.bitslicedKeys, aes.rounds, in, out, blocks);
+    }
+#endif
+
+    static uint32_t loadColumn(const uint8_t* p) {
+        return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+    }
+
+    static void storeColumn(uint8_t* p, uint32_t word) {
+        p[0] = (uint8_t)(word >> 24);
+        p[1] = (uint8_t)(word >> 16);
+        p[2] = (uint8_t)(word >> 8);
+        p[3] = (uint8_t)word;
+    }
+
+    static uint8_t xtime(uint8_t x) {
+        return (uint8_t)((x << 1) ^ (0x1b & (0 - (x >> 7))));
+    }
+
+    // InvMixColumns of one column, without tables so the key schedule
+    // does not index memory by key bytes
+    static uint32_t invMixColumn(uint32_t word) {
+        uint8_t x[4], x2[4], x4[4], x8[4];
+        for (int r = 0; r < 4; r++) {
+            x[r] = (uint8_t)(word >> (24 - 8 * r));
+            x2[r] = xtime(x[r]);
+            x4[r] = xtime(x2[r]);
+            x8[r] = xtime(x4[r]);
+        }
+        uint32_t result = 0;
+        for (int r = 0; r < 4; r++) {
+            int r1 = (r + 1) & 3, r2 = (r + 2) & 3, r3 = (r + 3) & 3;
+            // 14a ^ 11b ^ 13c ^ 9d
+            uint8_t out = (x8[r] ^ x4[r] ^ x2[r]) ^ (x8[r1] ^ x2[r1] ^ x[r1])
+                        ^ (x8[r2] ^ x4[r2] ^ x[r2]) ^ (x8[r3] ^ x[r3]);
+            result |= (uint32_t)out << (24 - 8 * r);
+        }
+        return result;
+    }
+
+    void expandKey(const uint8_t* key, size_t keyLength) {
+        // The constant-time backend also needs a schedule without S-box lookups
+        uint8_t (*sbox)(uint8_t) = [](uint8_t x) { return SBOX[x]; };
+#ifdef HAVE_X86_SIMD
+        if (blocksFunction() == bitslicedBlocks) {
+            sbox = constantTimeSbox;
+        }
+#endif
+        rounds = expandAESKey(key, keyLength, roundKeys, sbox);
+
+        // Round keys in reverse order, with InvMixColumns on all but the
+        // first and last
+        for (int round = 0; round <= rounds; round++) {
+            for (int c = 0; c < 4; c++) {
+                uint32_t word = roundKeys[4 * (rounds - round) + c];
+                decryptKeys[4 * round + c] = (round == 0 || round == rounds) ? word : invMixColumn(word);
+            }
+        }
+        for (int i = 0; i < 4 * (rounds + 1); i++) {
+            storeColumn(roundKeyBytes + 4 * i, roundKeys[i]);
+            storeColumn(decryptKeyBytes + 4 * i, decryptKeys[i]);
+        }
+#ifdef HAVE_X86_SIMD
+        if (cpuHasSSSE3()) {
+            bitslicedKeySchedule(roundKeys, rounds, bitslicedKeys);
+        }
+#endif
+    }
+
+    void portableBlock(const uint8_t in[16], uint8_t out[16]) const {
+        const uint32_t (&te)[4][256] = AES_TABLES.TE;
+        const uint32_t* rk = roundKeys;
+        uint32_t s0 = loadColumn(in) ^ rk[0];
+        uint32_t s1 = loadColumn(in + 4) ^ rk[1];
+        uint32_t s2 = loadColumn(in + 8) ^ rk[2];
+        uint32_t s3 = loadColumn(in + 12) ^ rk[3];
+
+        // Row r of output column c comes from input column c + r (ShiftRows)
+        for (int round = 1; round < rounds; round++) {
+            rk += 4;
+            uint32_t t0 = te[0][s0 >> 24] ^ te[1][(s1 >> 16) & 0xff] ^ te[2][(s2 >> 8) & 0xff] ^ te[3][s3 & 0xff] ^ rk[0];
+            uint32_t t1 = te[0][s1 >> 24] ^ te[1][(s2 >> 16) & 0xff] ^ te[2][(s3 >> 8) & 0xff] ^ te[3][s0 & 0xff] ^ rk[1];
+            uint32_t t2 = te[0][s2 >> 24] ^ te[1][(s3 >> 16) & 0xff] ^ te[2][(s0 >> 8) & 0xff] ^ te[3][s1 & 0xff] ^ rk[2];
+            uint32_t t3 = te[0][s3 >> 24] ^ te[1][(s0 >> 16) & 0xff] ^ te[2][(s1 >> 8) & 0xff] ^ te[3][s2 & 0xff] ^ rk[3];
+            s0 = t0;
+            s1 = t1;
+            s2 = t2;
+            s3 = t3;
+        }
+
+        // Final round has no MixColumns: plain S-box bytes
+        rk += 4;
+        uint32_t state[4] = { s0, s1, s2, s3 };
+        for (int c = 0; c < 4; c++) {
+            uint32_t word = ((uint32_t)SBOX[state[c] >> 24] << 24)
+                          | ((uint32_t)SBOX[(state[(c + 1) & 3] >> 16) & 0xff] << 16)
+                          | ((uint32_t)SBOX[(state[(c + 2) & 3] >> 8) & 0xff] << 8)
+                          | SBOX[state[(c + 3) & 3] & 0xff];
+            storeColumn(out + 4 * c, word ^ rk[c]);
+        }
+    }
+
+    // Equivalent inverse cipher: row r of output column c comes from input
+    // column c - r (InvShiftRows)
+    void portableDecryptBlock(const uint8_t in[16], uint8_t out[16]) const {
+        const uint32_t (&td)[4][256] = AES_TABLES.TD;
+        const uint32_t* rk = decryptKeys;
+        uint32_t s0 = loadColumn(in) ^ rk[0];
+        uint32_t s1 = loadColumn(in + 4) ^ rk[1];
+        uint32_t s2 = loadColumn(in + 8) ^ rk[2];
+        uint32_t s3 = loadColumn(in + 12) ^ rk[3];
+
+        for (int round = 1; round < rounds; round++) {
+            rk += 4;
+            uint32_t t0 = td[0][s0 >> 24] ^ td[1][(s3 >> 16) & 0xff] ^ td[2][(s2 >> 8) & 0xff] ^ td[3][s1 & 0xff] ^ rk[0];
+            uint32_t t1 = td[0][s1 >> 24] ^ td[1][(s0 >> 16) & 0xff] ^ td[2][(s3 >> 8) & 0xff] ^ td[3][s2 & 0xff] ^ rk[1];
+            uint32_t t2 = td[0][s2 >> 24] ^ td[1][(s1 >> 16) & 0xff] ^ td[2][(s0 >> 8) & 0xff] ^ td[3][s3 & 0xff] ^ rk[2];
+            uint32_t t3 = td[0][s3 >> 24] ^ td[1][(s2 >> 16) & 0xff] ^ td[2][(s1 >> 8) & 0xff] ^ td[3][s0 & 0xff] ^ rk[3];
+            s0 = t0;
+            s1 = t1;
+            s2 = t2;
+            s3 = t3;
+        }
+
+        // Final round has no InvMixColumns: plain inverse S-box bytes
+        rk += 4;
+        uint32_t state[4] = { s0, s1, s2, s3 };
+        for (int c = 0; c < 4; c++) {
+            uint32_t word = ((uint32_t)INV_SBOX[state[c] >> 24] << 24)
+                          | ((uint32_t)INV_SBOX[(state[(c + 3) & 3] >> 16) & 0xff] << 16)
+                          | ((uint32_t)INV_SBOX[(state[(c + 2) & 3] >> 8) & 0xff] << 8)
+                          | INV_SBOX[state[(c + 1) & 3] & 0xff];
+            storeColumn(out + 4 * c, word ^ rk[c]);
+        }
+    }
+
+public:
+    static const size_t BLOCK_SIZE = 16;
+
+    // key must be 16, 24 or 32 bytes
+    FastAES(const uint8_t* key, size_t keyLength) {
+        if (keyLength != 16 && keyLength != 24 && keyLength != 32) {
+            throw invalid_argument("AES key must be 128, 192 or 256 bits");
+        }
+        expandKey(key, keyLength);
+    }
+
+    explicit FastAES(const vector<unsigned char>& key) : FastAES(key.data(), key.size()) {}
+
+    int roundCount() const {
+        return rounds;
+    }
+
+    // Name of the backend in use
+    static string backend() {
+#ifdef HAVE_X86_SIMD
+        if (blocksFunction() == bitslicedBlocks) {
+            return "bitsliced (constant time)";
+        }
+#endif
+        return blocksFunction() == portableBlocks ? "portable T-tables" : "AES-NI";
+    }
+
+    static bool hasAESNI() {
+        return cpuHasAESNI();
+    }
+
+    void encryptBlock(const uint8_t in[16], uint8_t out[16]) const {
+        blocksFunction()(*this, in, out, 1);
+    }
+
+    // Independent blocks (ECB); in and out may be the same buffer
+    void encryptBlocks(const uint8_t* in, uint8_t* out, size_t blocks) const {
+        blocksFunction()(*this, in, out, blocks);
+    }
+
+    // Force a backend, e.g. to check one against the other. AES-NI needs
+    // hasAESNI(), bitsliced needs BitslicedAES::available().
+    void encryptBlocksPortable(const uint8_t* in, uint8_t* out, size_t blocks) const {
+        portableBlocks(*this, in, out, blocks);
+    }
+
+#ifdef HAVE_X86_SIMD
+    void encryptBlocksAESNI(const uint8_t* in, uint8_t* out, size_t blocks) const {
+        aesniBlocks(*this, in, out, blocks);
+    }
+
+    void encryptBlocksBitsliced(const uint8_t* in, uint8_t* out, size_t blocks) const {
+        bitslicedBlocks(*this, in, out, blocks);
+    }
+#endif
+
+    void decryptBlock(const uint8_t in[16], uint8_t out[16]) const {
+        decryptFunction()(*this, in, out, 1);
+    }
+
+    void decryptBlocks(const uint8_t* in, uint8_t* out, size_t blocks) const {
+        decryptFunction()(*this, in, out, blocks);
+    }
+
+    void decryptBlocksPortable(const uint8_t* in, uint8_t* out, size_t blocks) const {
+        portableDecryptBlocks(*this, in, out, blocks);
+    }
+
+#ifdef HAVE_X86_SIMD
+    void decryptBlocksAESNI(const uint8_t* in, uint8_t* out, size_t blocks) const {
+        aesniDecryptBlocks(*this, in, out, blocks);
+    }
+#endif
+
+    // One block, same shape as AES::encrypt
+    vector<unsigned char> encrypt(const vector<unsigned char>& plaintext) const {
+        if (plaintext.size() != BLOCK_SIZE) {
+            throw invalid_argument("AES block must be 128 bits");
+        }
+        vector<unsigned char> ciphertext(BLOCK_SIZE);
+        encryptBlock(plaintext.data(), ciphertext.data());
+        return ciphertext;
+    }
+
+    vector<unsigned char> decrypt(const vector<unsigned char>& ciphertext) const {
+        if (ciphertext.size() != BLOCK_SIZE) {
+            throw invalid_argument("AES block must be 128 bits");
+        }
+        vector<unsigned char> plaintext(BLOCK_SIZE);
+        decryptBlock(ciphertext.data(), plaintext.data());
+        return plaintext;
+    }
+};
+
+// AES in counter mode (NIST SP 800-38A)
+// Block i of the keystream is AES(iv + i), with the IV read as one
+// big-endian 128-bit counter that wraps, as OpenSSL does. Any byte offset
+// therefore maps straight to a counter value: seeking costs nothing, and
+// large buffers are split into chunks that threads encrypt independently.
+// Keystream is made eight counter blocks per FastAES call, which keeps the
+// AES-NI pipeline full and is exactly one group for the bitsliced kernel
+// FastAES uses on hosts without AES-NI. Encryption and decryption are the
+// same operation.
+class AESCTR {
+private:
+    static const size_t BATCH_BLOCKS = 8;
+    static const size_t CHUNK_SIZE = 1 << 20; // Bytes per thread task
+
+    FastAES aes;
+    uint64_t ivHigh, ivLow;
+    uint64_t position; // Offset used by the next process() call
+
+    static uint64_t loadBigEndian64(const uint8_t* p) {
+        uint64_t value = 0;
+        for (int i = 0; i < 8; i++) {
+            value = (value << 8) | p[i];
+        }
+        return value;
+    }
+
+    static void storeBigEndian64(uint8_t* p, uint64_t value) {
+        value = __builtin_bswap64(value);
+        memcpy(p, &value, 8);
+    }
+
+    // Counter block for keystream block index: iv + index mod 2^128
+    void counterBlock(uint64_t index, uint8_t out[16]) const {
+        uint64_t low = ivLow + index;
+        storeBigEndian64(out, ivHigh + (low < ivLow ? 1 : 0));
+        storeBigEndian64(out + 8, low);
+    }
+
+    // out = in ^ keystream for bytes [offset, offset + length)
+    void xorKeystream(uint64_t offset, const uint8_t* in, uint8_t* out, size_t length) const {
+        uint8_t counters[BATCH_BLOCKS * 16], stream[BATCH_BLOCKS * 16];
+        uint64_t block = offset / 16;
+        size_t skip = (size_t)(offset % 16); // Only the first batch starts mid-block
+        size_t done = 0;
+        while (done < length) {
+            size_t blocks = min(BATCH_BLOCKS, (skip + length - done + 15) / 16);
+            for (size_t j = 0; j < blocks; j++) {
+                counterBlock(block + j, counters + 16 * j);
+            }
+            aes.encryptBlocks(counters, stream, blocks);
+            size_t count = min(blocks * 16 - skip, length - done);
+            size_t j = 0;
+            for (; j + 8 <= count; j += 8) {
+                uint64_t a, b;
+                memcpy(&a, in + done + j, 8);
+                memcpy(&b, stream + skip + j, 8);
+                a ^= b;
+                memcpy(out + done + j, &a, 8);
+            }
+            for (; j < count; j++) {
+                out[done + j] = in[done + j] ^ stream[skip + j];
+            }
+            done += count;
+            block += blocks;
+            skip = 0;
+        }
+    }
+
+public:
+    // key must be 16, 24 or 32 bytes; iv is the 16-byte initial counter block
+    AESCTR(const vector<unsigned char>& key, const vector<unsigned char>& iv) : aes(key), position(0) {
+        if (iv.size() != 16) {
+            throw invalid_argument("AES-CTR IV must be 128 bits");
+        }
+        ivHigh = loadBigEndian64(iv.data());
+        ivLow = loadBigEndian64(iv.data() + 8);
+    }
+
+    int roundCount() const {
+        return aes.roundCount();
+    }
+
+    // Block engine making the keystream
+    static string backend() {
+        return FastAES::backend();
+    }
+
+    void seek(uint64_t offset) {
+        position = offset;
+    }
+
+    uint64_t tell() const {
+        return position;
+    }
+
+    // Encrypt or decrypt length bytes as if they sit at byte offset of the
+    // stream; in and out may be the same buffer. Buffers larger than one
+    // chunk are spread over threads workers (0 = one per hardware thread).
+    // Does not move the stream position.
+    void processAt(uint64_t offset, const uint8_t* in, uint8_t* out, size_t length, unsigned threads = 1) const {
+        size_t chunks = (length + CHUNK_SIZE - 1) / CHUNK_SIZE;
+        if (threads == 0) {
+            threads = max(1u, thread::hardware_concurrency());
+        }
+        if (threads > chunks) {
+            threads = (unsigned)max<size_t>(chunks, 1);
+        }
+        if (threads == 1) {
+            xorKeystream(offset, in, out, length);
+            return;
+        }
+
+        // Each chunk is an independent counter range
+        atomic<size_t> next(0);
+        auto worker = [&]() {
+            for (size_t i = next++; i < chunks; i = next++) {
+                size_t start = i * CHUNK_SIZE;
+                xorKeystream(offset + start, in + start, out + start, min(CHUNK_SIZE, length - start));
+            }
+        };
+        vector<thread> pool;
+        for (unsigned t = 1; t < threads; t++) {
+            pool.emplace_back(worker);
+        }
+        worker();
+        for (thread& t : pool) {
+            t.join();
+        }
+    }
+
+    // Streaming use: continue from the current position and advance it
+    void process(const uint8_t* in, uint8_t* out, size_t length, unsigned threads = 1) {
+        processAt(position, in, out, length, threads);
+        position += length;
+    }
+
+    vector<unsigned char> process(const vector<unsigned char>& data, unsigned threads = 1) {
+        vector<unsigned char> out(data.size());
+        process(data.data(), out.data(), data.size(), threads);
+        return out;
     }
 };
 
@@ -350,22 +1250,11 @@ public:
     }
 
     static string hexToBinary(const string& hex) {
-        stringstream binary;
-        for(char c : hex) {
-            int value = (c >= 'A') ? (c - 'A' + 10) : (c - '0');
-            binary << bitset<4>(value);
-        }
-        return binary.str();
+        return hexToBitString(hex);
     }
 
     static string binaryToHex(const string& binary) {
-        stringstream hex;
-        hex << std::hex << std::setfill('0');
-        for(size_t i = 0; i < binary.length(); i += 4) {
-            string chunk = binary.substr(i, 4);
-            hex << std::setw(1) << std::stoi(chunk, nullptr, 2);
-        }
-        return hex.str();
+        return bitStringToHex(binary);
     }
 };
 
@@ -414,22 +1303,11 @@ public:
 
 private:
     vector<unsigned char> hexToBytes(const string& hex) {
-        vector<unsigned char> bytes;
-        for(size_t i = 0; i < hex.length(); i += 2) {
-            string byteString = hex.substr(i, 2);
-            unsigned char byte = stoi(byteString, nullptr, 16);
-            bytes.push_back(byte);
-        }
-        return bytes;
+        return hexDecode(hex);
     }
 
     string bytesToHex(const vector<unsigned char>& bytes) {
-        stringstream ss;
-        ss << hex << setfill('0');
-        for(unsigned char byte : bytes) {
-            ss << setw(2) << static_cast<int>(byte);
-        }
-        return ss.str();
+        return hexEncode(bytes);
     }
 };
 
@@ -439,6 +1317,202 @@ private:
     SDES sdes;
     RC4 rc4;
 
+    // Check every AES path against the FIPS-197 known answers and against
+    // each other, then time the fast backends
+    void runAESSelfTest() {
+        struct KnownAnswer {
+            const char* name;
+            const char* key;
+            const char* plaintext;
+            const char* ciphertext;
+        };
+        const KnownAnswer vectors[] = {
+            { "AES-128 (FIPS-197 B)", "2b7e151628aed2a6abf7158809cf4f3c", "3243f6a8885a308d313198a2e0370734", "3925841d02dc09fbdc118597196a0b32" },
+            { "AES-128 (FIPS-197 C.1)", "000102030405060708090a0b0c0d0e0f", "00112233445566778899aabbccddeeff", "69c4e0d86a7b0430d8cdb78070b4c55a" },
+            { "AES-192 (FIPS-197 C.2)", "000102030405060708090a0b0c0d0e0f1011121314151617", "00112233445566778899aabbccddeeff", "dda97ca4864cdfe06eaf70a0ec0d7191" },
+            { "AES-256 (FIPS-197 C.3)", "000102030405060708090a0b0c0d0e0f101112131415161718191a1b1c1d1e1f", "00112233445566778899aabbccddeeff", "8ea2b7ca516745bfeafc49904b496089" },
+        };
+
+        cout << "\nAES backend: " << FastAES::backend() << endl << endl;
+        for (const KnownAnswer& v : vectors) {
+            vector<unsigned char> key = AES::hexToBytes(v.key);
+            vector<unsigned char> plaintext = AES::hexToBytes(v.plaintext);
+            vector<unsigned char> ciphertext = AES::hexToBytes(v.ciphertext);
+            FastAES fast(key);
+            vector<unsigned char> out(16);
+            bool ok = true;
+
+            cout << v.name << endl;
+            cout << "Expected: " << v.ciphertext << endl;
+            if (key.size() == 16) {
+                string teaching = AES::bytesToHex(AES(key, false).encrypt(plaintext));
+                cout << "Teaching: " << teaching << endl;
+                ok = ok && teaching == v.ciphertext;
+            }
+            fast.encryptBlocksPortable(plaintext.data(), out.data(), 1);
+            cout << "Portable: " << AES::bytesToHex(out) << endl;
+            ok = ok && AES::bytesToHex(out) == v.ciphertext;
+#ifdef HAVE_X86_SIMD
+            if (FastAES::hasAESNI()) {
+                fast.encryptBlocksAESNI(plaintext.data(), out.data(), 1);
+                cout << "AES-NI:   " << AES::bytesToHex(out) << endl;
+                ok = ok && AES::bytesToHex(out) == v.ciphertext;
+            }
+            if (BitslicedAES::available()) {
+                BitslicedAES(key).encryptBlock(plaintext.data(), out.data());
+                cout << "Bitslice: " << AES::bytesToHex(out) << endl;
+                ok = ok && AES::bytesToHex(out) == v.ciphertext;
+                fast.encryptBlocksBitsliced(plaintext.data(), out.data(), 1);
+                ok = ok && AES::bytesToHex(out) == v.ciphertext;
+            }
+#endif
+
+            // Decryption must give the plaintext back on every path
+            cout << "Decrypt:  " << v.plaintext << endl;
+            if (key.size() == 16) {
+                string teaching = AES::bytesToHex(AES(key, false).decrypt(ciphertext));
+                cout << "Teaching: " << teaching << endl;
+                ok = ok && teaching == v.plaintext;
+            }
+            fast.decryptBlocksPortable(ciphertext.data(), out.data(), 1);
+            cout << "Portable: " << AES::bytesToHex(out) << endl;
+            ok = ok && AES::bytesToHex(out) == v.plaintext;
+#ifdef HAVE_X86_SIMD
+            if (FastAES::hasAESNI()) {
+                fast.decryptBlocksAESNI(ciphertext.data(), out.data(), 1);
+                cout << "AES-NI:   " << AES::bytesToHex(out) << endl;
+                ok = ok && AES::bytesToHex(out) == v.plaintext;
+            }
+#endif
+            cout << "Result:   " << (ok ? "PASS" : "FAIL") << endl << endl;
+        }
+
+        // 16 MiB plus five blocks, so the 8-block pipeline also ends in a tail
+        vector<uint8_t> data((16 << 20) + 5 * 16);
+        for (size_t i = 0; i < data.size(); i++) {
+            data[i] = (uint8_t)(i * 131 + (i >> 9));
+        }
+        FastAES fast(AES::hexToBytes(vectors[3].key));
+        vector<uint8_t> portable(data.size()), hardware(data.size());
+        auto time = [&](const function<void()>& run) {
+            auto start = chrono::steady_clock::now();
+            run();
+            return data.size() / chrono::duration<double>(chrono::steady_clock::now() - start).count() / 1e6;
+        };
+        double portableRate = time([&]() { fast.encryptBlocksPortable(data.data(), portable.data(), data.size() / 16); });
+        cout << "AES-256 portable:  " << fixed << setprecision(0) << portableRate << " MB/s" << endl;
+#ifdef HAVE_X86_SIMD
+        if (FastAES::hasAESNI()) {
+            double hardwareRate = time([&]() { fast.encryptBlocksAESNI(data.data(), hardware.data(), data.size() / 16); });
+            bool match = portable == hardware;
+            cout << "AES-256 AES-NI:    " << hardwareRate << " MB/s" << endl;
+            cout << "Backends agree on " << data.size() / 16 << " blocks: " << (match ? "PASS" : "FAIL") << endl;
+        }
+        if (BitslicedAES::available()) {
+            BitslicedAES bitsliced(AES::hexToBytes(vectors[3].key));
+            double bitslicedRate = time([&]() { bitsliced.encryptBlocks(data.data(), hardware.data(), data.size() / 16); });
+            cout << "AES-256 bitsliced: " << bitslicedRate << " MB/s" << endl;
+            bool match = portable == hardware;
+            fast.encryptBlocksBitsliced(data.data(), hardware.data(), data.size() / 16);
+            match = match && portable == hardware;
+            cout << "Bitsliced agrees on " << data.size() / 16 << " blocks: " << (match ? "PASS" : "FAIL") << endl;
+        }
+#endif
+
+        // Decrypt the portable ciphertext back with each backend
+        vector<uint8_t> decrypted(data.size());
+        double decryptRate = time([&]() { fast.decryptBlocksPortable(portable.data(), decrypted.data(), data.size() / 16); });
+        cout << "AES-256 portable decrypt:  " << decryptRate << " MB/s" << endl;
+        cout << "Portable round trip on " << data.size() / 16 << " blocks: " << (decrypted == data ? "PASS" : "FAIL") << endl;
+#ifdef HAVE_X86_SIMD
+        if (FastAES::hasAESNI()) {
+            decryptRate = time([&]() { fast.decryptBlocksAESNI(portable.data(), decrypted.data(), data.size() / 16); });
+            cout << "AES-256 AES-NI decrypt:    " << decryptRate << " MB/s" << endl;
+            cout << "AES-NI round trip on " << data.size() / 16 << " blocks: " << (decrypted == data ? "PASS" : "FAIL") << endl;
+        }
+#endif
+        cout.unsetf(ios::floatfield);
+        runCTRSelfTest(data);
+    }
+
+    // CTR mode: SP 800-38A known answers, then seeking, streaming in odd
+    // pieces and threaded runs must all match one sequential pass over data
+    void runCTRSelfTest(const vector<uint8_t>& data) {
+        struct KnownAnswer {
+            const char* name;
+            const char* key;
+            const char* ciphertext;
+        };
+        const char* iv = "f0f1f2f3f4f5f6f7f8f9fafbfcfdfeff";
+        const char* plaintext = "6bc1bee22e409f96e93d7e117393172aae2d8a571e03ac9c9eb76fac45af8e51"
+                                "30c81c46a35ce411e5fbc1191a0a52eff69f2445df4f9b17ad2b417be66c3710";
+        const KnownAnswer vectors[] = {
+            { "AES-128-CTR (SP 800-38A F.5.1)", "2b7e151628aed2a6abf7158809cf4f3c",
+              "874d6191b620e3261bef6864990db6ce9806f66b7970fdff8617187bb9fffdff"
+              "5ae4df3edbd5d35e5b4f09020db03eab1e031dda2fbe03d1792170a0f3009cee" },
+            { "AES-192-CTR (SP 800-38A F.5.3)", "8e73b0f7da0e6452c810f32b809079e562f8ead2522c6b7b",
+              "1abc932417521ca24f2b0459fe7e6e0b090339ec0aa6faefd5ccc2c6f4ce8e94"
+              "1e36b26bd1ebc670d1bd1d665620abf74f78a7f6d29809585a97daec58c6b050" },
+            { "AES-256-CTR (SP 800-38A F.5.5)", "603deb1015ca71be2b73aef0857d77811f352c073b6108d72d9810a30914dff4",
+              "601ec313775789a5b7a7f504bbf3d228f443e3ca4d62b59aca84e990cacaf5c5"
+              "2b0930daa23de94ce87017ba2d84988ddfc9c58db67aada613c2dd08457941a6" },
+        };
+
+        cout << "\nAES-CTR engine: " << AESCTR::backend() << endl;
+        for (const KnownAnswer& v : vectors) {
+            AESCTR ctr(AES::hexToBytes(v.key), AES::hexToBytes(iv));
+            string encrypted = AES::bytesToHex(ctr.process(AES::hexToBytes(plaintext)));
+            ctr.seek(0);
+            string decrypted = AES::bytesToHex(ctr.process(AES::hexToBytes(v.ciphertext)));
+            cout << v.name << ": " << (encrypted == v.ciphertext && decrypted == plaintext ? "PASS" : "FAIL") << endl;
+        }
+
+        // The counter carries across all 128 bits: ff..ff is followed by 00..00
+        vector<unsigned char> key = AES::hexToBytes(vectors[0].key);
+        vector<unsigned char> zero(16, 0);
+        AESCTR wrap(key, vector<unsigned char>(16, 0xff));
+        vector<unsigned char> stream = wrap.process(vector<unsigned char>(32, 0));
+        bool wrapped = vector<unsigned char>(stream.begin() + 16, stream.end()) == FastAES(key).encrypt(zero);
+        cout << "Counter wraps at 2^128: " << (wrapped ? "PASS" : "FAIL") << endl;
+
+        AESCTR ctr(AES::hexToBytes("603deb1015ca71be2b73aef0857d77811f352c073b6108d72d9810a30914dff4"), AES::hexToBytes(iv));
+        vector<uint8_t> reference(data.size()), out(data.size());
+        auto start = chrono::steady_clock::now();
+        ctr.processAt(0, data.data(), reference.data(), data.size(), 1);
+        double oneThread = data.size() / chrono::duration<double>(chrono::steady_clock::now() - start).count() / 1e6;
+        // At least four workers, so the chunked path runs even on one core
+        unsigned threads = max(4u, thread::hardware_concurrency());
+        start = chrono::steady_clock::now();
+        ctr.processAt(0, data.data(), out.data(), data.size(), threads);
+        double allThreads = data.size() / chrono::duration<double>(chrono::steady_clock::now() - start).count() / 1e6;
+        bool ok = out == reference;
+
+        // Odd-sized streaming pieces cross block and batch boundaries
+        ctr.seek(0);
+        for (size_t done = 0, piece = 1; done < data.size(); piece = piece * 7 % 4099 + 1) {
+            size_t length = min(piece, data.size() - done);
+            ctr.process(data.data() + done, out.data() + done, length);
+            done += length;
+        }
+        ok = ok && out == reference;
+        cout << "Threaded and streamed runs agree on " << data.size() << " bytes: " << (ok ? "PASS" : "FAIL") << endl;
+
+        // Decrypt short ranges at arbitrary offsets, in place
+        ok = true;
+        for (size_t i = 0; i < 64; i++) {
+            size_t offset = (i * 2654435761u) % data.size();
+            size_t length = min<size_t>(1 + i * 37, data.size() - offset);
+            vector<uint8_t> part(reference.begin() + offset, reference.begin() + offset + length);
+            ctr.processAt(offset, part.data(), part.data(), length);
+            ok = ok && equal(part.begin(), part.end(), data.begin() + offset);
+        }
+        cout << "Seek and decrypt at 64 offsets: " << (ok ? "PASS" : "FAIL") << endl;
+
+        cout << "AES-256-CTR 1 thread:  " << fixed << setprecision(0) << oneThread << " MB/s" << endl;
+        cout << "AES-256-CTR " << threads << " threads: " << allThreads << " MB/s" << endl;
+        cout.unsetf(ios::floatfield);
+    }
+
 public:
     SymmetricEncryptionTool() : sdes("1010101010") {}
 
@@ -450,10 +1524,22 @@ public:
             cout << "3. RC4 Encryption\n";
             cout << "4. RC4 Decryption\n";
             cout << "5. AES Encryption\n";
-            cout << "6. Exit\n";
-            cout << "Enter your choice (1-6): ";
+            cout << "6. AES Decryption\n";
+            cout << "7. AES Encryption (fast, 128/192/256-bit key)\n";
+            cout << "8. AES Decryption (fast, 128/192/256-bit key)\n";
+            cout << "9. AES-CTR Encryption/Decryption (any length, with seek)\n";
+            cout << "10. AES Self-Test (FIPS-197 vectors)\n";
+            cout << "11. Exit\n";
+            cout << "Enter your choice (1-11): ";
             int choice;
-            cin >> choice;
+            if (!(cin >> choice)) {
+                if (cin.eof()) {
+                    return;
+                }
+                cin.clear();
+                cin.ignore(numeric_limits<streamsize>::max(), '\n');
+                choice = 0;
+            }
 
             switch(choice) {
                 case 1: {
@@ -539,7 +1625,72 @@ public:
                     }
                     break;
                 }
-                case 6:
+                case 6: {
+                    string input, keyHex;
+                    cout << "Enter 128-bit ciphertext in hex (32 hex characters): ";
+                    cin >> input;
+                    cout << "Enter 128-bit key in hex (32 hex characters): ";
+                    cin >> keyHex;
+
+                    AES aes(AES::hexToBytes(keyHex));
+                    vector<unsigned char> plaintext = aes.decrypt(AES::hexToBytes(input));
+                    cout << "Plaintext (hex): " << AES::bytesToHex(plaintext) << endl;
+                    break;
+                }
+                case 7: {
+                    string input, keyHex;
+                    cout << "Enter 128-bit input in hex (32 hex characters): ";
+                    cin >> input;
+                    cout << "Enter key in hex (32, 48 or 64 hex characters): ";
+                    cin >> keyHex;
+
+                    FastAES aes(AES::hexToBytes(keyHex));
+                    vector<unsigned char> ciphertext = aes.encrypt(AES::hexToBytes(input));
+                    cout << "AES-" << (aes.roundCount() - 6) * 32 << " Ciphertext (hex): "
+                         << AES::bytesToHex(ciphertext) << endl;
+                    break;
+                }
+                case 8: {
+                    string input, keyHex;
+                    cout << "Enter 128-bit ciphertext in hex (32 hex characters): ";
+                    cin >> input;
+                    cout << "Enter key in hex (32, 48 or 64 hex characters): ";
+                    cin >> keyHex;
+
+                    FastAES aes(AES::hexToBytes(keyHex));
+                    vector<unsigned char> plaintext = aes.decrypt(AES::hexToBytes(input));
+                    cout << "AES-" << (aes.roundCount() - 6) * 32 << " Plaintext (hex): "
+                         << AES::bytesToHex(plaintext) << endl;
+                    break;
+                }
+                case 9: {
+                    string input, keyHex, ivHex;
+                    uint64_t offset;
+                    cout << "Enter input in hex: ";
+                    cin >> input;
+                    cout << "Enter key in hex (32, 48 or 64 hex characters): ";
+                    cin >> keyHex;
+                    cout << "Enter 128-bit initial counter block in hex (32 hex characters): ";
+                    cin >> ivHex;
+                    cout << "Enter byte offset of the input in the stream (0 for the start): ";
+                    if (!(cin >> offset)) {
+                        cin.clear();
+                        cin.ignore(numeric_limits<streamsize>::max(), '\n');
+                        cerr << "Invalid offset!\n";
+                        break;
+                    }
+
+                    AESCTR ctr(AES::hexToBytes(keyHex), AES::hexToBytes(ivHex));
+                    ctr.seek(offset);
+                    vector<unsigned char> output = ctr.process(AES::hexToBytes(input));
+                    cout << "AES-" << (ctr.roundCount() - 6) * 32 << "-CTR Result (hex): "
+                         << AES::bytesToHex(output) << endl;
+                    break;
+                }
+                case 10:
+                    runAESSelfTest();
+                    break;
+                case 11:
                     cout << "Exiting...\n";
                     return;
                 default:
@@ -552,7 +1703,15 @@ public:
 int main() {
     try {
         SymmetricEncryptionTool tool;
-        tool.runMainMenu();
+        // Bad hex or key input is reported and the menu shown again
+        while (true) {
+            try {
+                tool.runMainMenu();
+                break;
+            } catch(const invalid_argument& e) {
+                cerr << "Error: " << e.what() << endl;
+            }
+        }
     } catch(const exception& e) {
         cerr << "Error: " << e.what() << endl;
         return 1;
@@ -0,0 +1,281 @@
+// NIST CAVP response-file runner for the hash implementations.
+// Reads SHAVS-style .rsp files (ShortMsg, LongMsg and Monte Carlo), checks
+// every vector on a thread pool and reports counts and timing:
+//   g++ -O2 -pthread CAVPRunner.cpp -o CAVPRunner
+//   ./CAVPRunner SHA512ShortMsg.rsp SHA512LongMsg.rsp SHA512Monte.rsp
+// The algorithm comes from the file name (SHA512, SHA384, SHA512_224,
+// SHA512_256, SHA256, MD5) unless --algo is given. MD5 has no NIST vectors;
+// files in the same format are accepted for it. Like HashBench, this
+// compiles the hash programs in with their main() renamed.
+#define main dd_main
+#include "dd.cpp"
+#undef main
+#define main sha256_main
+#include "SHA512.cpp"
+#undef main
+
+struct CAVPAlgorithm {
+    string name;
+    size_t digestSize;
+    function<void(const uint8*, size_t, uint8*)> hash;
+};
+
+template <typename Hasher>
+CAVPAlgorithm cavpAlgorithm(const string& name) {
+    return { name, Hasher::DIGEST_SIZE, [](const uint8* data, size_t length, uint8* digest) {
+        Hasher hasher;
+        hasher.update(data, length);
+        hasher.final(digest);
+    } };
+}
+
+// SHA256 in SHA512.cpp has no DIGEST_SIZE constant
+CAVPAlgorithm sha256Algorithm() {
+    return { "SHA-256", 32, [](const uint8* data, size_t length, uint8* digest) {
+        SHA256 hasher;
+        hasher.update(data, length);
+        hasher.final(digest);
+    } };
+}
+
+// Match --algo values and file-name prefixes, longest names first
+bool findAlgorithm(string name, CAVPAlgorithm& algorithm) {
+    transform(name.begin(), name.end(), name.begin(), ::toupper);
+    replace(name.begin(), name.end(), '-', '_');
+    if (name.compare(0, 10, "SHA512_224") == 0) {
+        algorithm = cavpAlgorithm<SHA512_224>("SHA-512/224");
+    } else if (name.compare(0, 10, "SHA512_256") == 0) {
+        algorithm = cavpAlgorithm<SHA512_256>("SHA-512/256");
+    } else if (name.compare(0, 6, "SHA512") == 0) {
+        algorithm = cavpAlgorithm<SHA512>("SHA-512");
+    } else if (name.compare(0, 6, "SHA384") == 0) {
+        algorithm = cavpAlgorithm<SHA384>("SHA-384");
+    } else if (name.compare(0, 6, "SHA256") == 0) {
+        algorithm = sha256Algorithm();
+    } else if (name.compare(0, 3, "MD5") == 0) {
+        algorithm = cavpAlgorithm<MD5>("MD5");
+    } else {
+        return false;
+    }
+    return true;
+}
+
+// One unit of work: a single message vector, or a whole Monte Carlo chain
+// (each checkpoint seeds the next, so a chain cannot be split)
+struct CAVPJob {
+    size_t file;
+    string label;
+    bool monteCarlo;
+    vector<unsigned char> message; // Message, or the Monte Carlo seed
+    vector<vector<unsigned char>> expected; // One digest, or one per COUNT
+    bool passed;
+    string failure;
+};
+
+struct CAVPFile {
+    string path;
+    CAVPAlgorithm algorithm;
+    size_t vectors, passed, skipped;
+};
+
+string trimLine(const string& line) {
+    size_t start = line.find_first_not_of(" \t\r");
+    size_t end = line.find_last_not_of(" \t\r");
+    return start == string::npos ? "" : line.substr(start, end - start + 1);
+}
+
+// Read one .rsp file line by line into jobs; bit-oriented vectors (Len not a
+// multiple of 8) are counted as skipped
+void parseResponseFile(size_t fileIndex, CAVPFile& file, vector<CAVPJob>& jobs) {
+    ifstream in(file.path);
+    if (!in) {
+        throw runtime_error(file.path + ": " + strerror(errno));
+    }
+    size_t lineNumber = 0;
+    string line;
+    long long length = -1;
+    vector<unsigned char> message;
+    size_t monte = SIZE_MAX; // Index of the Monte Carlo job being read
+    string count;
+    try {
+        while (getline(in, line)) {
+            lineNumber++;
+            line = trimLine(line);
+            if (line.empty() || line[0] == '#') {
+                continue;
+            }
+            if (line[0] == '[') {
+                // "[L = 64]" gives the digest length in bytes
+                size_t equals = line.find('=');
+                if (line.compare(0, 2, "[L") == 0 && equals != string::npos
+                    && stoul(line.substr(equals + 1)) != file.algorithm.digestSize) {
+                    throw runtime_error("digest length does not match " + file.algorithm.name);
+                }
+                continue;
+            }
+            size_t equals = line.find('=');
+            if (equals == string::npos) {
+                throw runtime_error("unexpected line");
+            }
+            string key = trimLine(line.substr(0, equals));
+            string value = trimLine(line.substr(equals + 1));
+
+            if (key == "Len") {
+                length = stoll(value);
+            } else if (key == "Msg") {
+                message = hexDecode(value);
+            } else if (key == "MD" && monte == SIZE_MAX) {
+                if (length < 0) {
+                    throw runtime_error("MD without Len");
+                }
+                file.vectors++;
+                if (length % 8 != 0) {
+                    file.skipped++;
+                } else {
+                    message.resize(length / 8); // "Msg = 00" stands for the empty message
+                    jobs.push_back({ fileIndex, "Len = " + to_string(length), false, message, { hexDecode(value) }, false, "" });
+                }
+                length = -1;
+            } else if (key == "Seed") {
+                jobs.push_back({ fileIndex, "Monte Carlo", true, hexDecode(value), {}, false, "" });
+                monte = jobs.size() - 1;
+            } else if (key == "COUNT") {
+                count = value;
+            } else if (key == "MD") {
+                if (count != to_string(jobs[monte].expected.size())) {
+                    throw runtime_error("Monte Carlo COUNT out of order");
+                }
+                jobs[monte].expected.push_back(hexDecode(value));
+                file.vectors++;
+            } else {
+                throw runtime_error("unknown field " + key);
+            }
+        }
+    } catch (const exception& e) {
+        throw runtime_error(file.path + ":" + to_string(lineNumber) + ": " + e.what());
+    }
+}
+
+// SHAVS Monte Carlo test: each checkpoint runs 1000 iterations of
+// MD[i] = H(MD[i-3] || MD[i-2] || MD[i-1]) starting from three copies of
+// the seed, and its result seeds the next checkpoint
+void runMonteCarlo(const CAVPAlgorithm& algorithm, CAVPJob& job) {
+    size_t size = algorithm.digestSize;
+    vector<uint8> window(3 * size), next(size);
+    vector<unsigned char> seed = job.message;
+    if (seed.size() != size) {
+        job.failure = "seed length does not match the digest size";
+        return;
+    }
+    for (size_t checkpoint = 0; checkpoint < job.expected.size(); checkpoint++) {
+        for (int i = 0; i < 3; i++) {
+            memcpy(&window[i * size], seed.data(), size);
+        }
+        for (int i = 3; i < 1003; i++) {
+            algorithm.hash(window.data(), window.size(), next.data());
+            memmove(&window[0], &window[size], 2 * size);
+            memcpy(&window[2 * size], next.data(), size);
+        }
+        seed.assign(next.begin(), next.end());
+        if (seed != job.expected[checkpoint]) {
+            job.failure = "COUNT = " + to_string(checkpoint) + ": expected " + hexEncode(job.expected[checkpoint])
+                        + ", got " + hexEncode(seed);
+            return;
+        }
+    }
+    job.passed = true;
+}
+
+void runJob(const CAVPAlgorithm& algorithm, CAVPJob& job) {
+    if (job.monteCarlo) {
+        runMonteCarlo(algorithm, job);
+        return;
+    }
+    vector<uint8> digest(algorithm.digestSize);
+    algorithm.hash(job.message.data(), job.message.size(), digest.data());
+    job.passed = job.expected[0] == vector<unsigned char>(digest.begin(), digest.end());
+    if (!job.passed) {
+        job.failure = "expected " + hexEncode(job.expected[0]) + ", got " + hexEncode(digest);
+    }
+}
+
+void printRunnerUsage(const char* program) {
+    cerr << "Usage: " << program << " [--algo sha512|sha384|sha512-224|sha512-256|sha256|md5] [--threads N] FILE.rsp..." << endl;
+}
+
+int main(int argc, char* argv[]) {
+    string algorithmName;
+    unsigned threads = 0;
+    vector<string> paths;
+    try {
+        for (int i = 1; i < argc; i++) {
+            string arg = argv[i];
+            if ((arg == "--algo" || arg == "--threads") && i + 1 < argc) {
+                if (arg == "--algo") {
+                    algorithmName = argv[++i];
+                } else {
+                    threads = (unsigned)parseCount(arg, argv[++i]);
+                }
+            } else {
+                paths.push_back(arg);
+            }
+        }
+        if (paths.empty()) {
+            throw invalid_argument("no response files given");
+        }
+    } catch (const invalid_argument& e) {
+        cerr << "Error: " << e.what() << endl;
+        printRunnerUsage(argv[0]);
+        return 2;
+    }
+
+    vector<CAVPFile> files;
+    vector<CAVPJob> jobs;
+    auto start = chrono::steady_clock::now();
+    try {
+        for (const string& path : paths) {
+            CAVPFile file = { path, CAVPAlgorithm(), 0, 0, 0 };
+            string base = path.substr(path.find_last_of('/') + 1);
+            if (!findAlgorithm(algorithmName.empty() ? base : algorithmName, file.algorithm)) {
+                throw runtime_error(path + ": cannot tell the algorithm; use --algo");
+            }
+            files.push_back(file);
+            parseResponseFile(files.size() - 1, files.back(), jobs);
+        }
+    } catch (const exception& e) {
+        cerr << "Error: " << e.what() << endl;
+        return 2;
+    }
+    double parseSeconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    // Jobs are ordered file by file; long Monte Carlo chains run alongside
+    // the message vectors on the same pool
+    start = chrono::steady_clock::now();
+    parallelFor(jobs.size(), threads, [&](size_t i) {
+        runJob(files[jobs[i].file].algorithm, jobs[i]);
+    });
+    double checkSeconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    size_t failures = 0, vectors = 0;
+    for (const CAVPJob& job : jobs) {
+        CAVPFile& file = files[job.file];
+        size_t counted = job.monteCarlo ? job.expected.size() : 1;
+        if (job.passed) {
+            file.passed += counted;
+        } else {
+            failures++;
+            cout << "FAIL " << file.path << " " << job.label << ": " << job.failure << endl;
+        }
+    }
+    for (const CAVPFile& file : files) {
+        vectors += file.vectors;
+        cout << file.path << " (" << file.algorithm.name << "): " << file.passed << "/" << file.vectors << " passed";
+        if (file.skipped > 0) {
+            cout << ", " << file.skipped << " bit-oriented skipped";
+        }
+        cout << endl;
+    }
+    cout << fixed << setprecision(3) << vectors << " vectors in " << parseSeconds << " s parsing + "
+         << checkSeconds << " s checking (" << setprecision(0) << vectors / max(checkSeconds, 1e-9) << " vectors/s)" << endl;
+    return failures == 0 ? 0 : 1;
+}
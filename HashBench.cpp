@@ -0,0 +1,302 @@
+// Hash throughput benchmark across every hash implementation in the repo.
+// The other programs are compiled into this one with their main() renamed,
+// so it always measures the current code:
+//   g++ -O2 -pthread HashBench.cpp -o HashBench
+// Each implementation is timed per message size: one warm-up call, then the
+// iteration count is calibrated so a trial lasts at least --min-time
+// seconds, and the fastest of --repeat trials is reported. The benchmark
+// thread is pinned to one CPU so runs are comparable. Cycles are TSC
+// reference cycles read with rdtsc.
+#define main dd_main
+#include "dd.cpp"
+#undef main
+#define main dd1_main
+#include "dd1.cpp"
+#undef main
+#define main sha256_main
+#include "SHA512.cpp"
+#undef main
+
+#include <sched.h>
+#ifdef HAVE_X86_SIMD
+#include <x86intrin.h>
+#endif
+
+// TSC reference cycles; zero where there is no TSC
+uint64 readCycles() {
+#ifdef HAVE_X86_SIMD
+    return __rdtsc();
+#else
+    return 0;
+#endif
+}
+
+struct BenchTarget {
+    string name;
+    size_t messagesPerCall; // Multi-buffer targets hash a batch per call
+    function<void(const string&, uint8*)> run;
+};
+
+struct BenchResult {
+    string name;
+    size_t size;
+    size_t messages;
+    double seconds;
+    double cycles;
+};
+
+// Parse "0", "64", "16K", "1M", "1G" (powers of 1024)
+size_t parseSize(const string& text) {
+    size_t used = 0;
+    unsigned long long value = 0;
+    try {
+        value = stoull(text, &used);
+    } catch (const exception&) {
+        throw invalid_argument("invalid size: " + text);
+    }
+    string suffix = text.substr(used);
+    if (suffix == "K" || suffix == "k") {
+        value <<= 10;
+    } else if (suffix == "M" || suffix == "m") {
+        value <<= 20;
+    } else if (suffix == "G" || suffix == "g") {
+        value <<= 30;
+    } else if (!suffix.empty()) {
+        throw invalid_argument("invalid size: " + text);
+    }
+    return value;
+}
+
+vector<size_t> parseSizeList(const string& list) {
+    vector<size_t> sizes;
+    stringstream ss(list);
+    string item;
+    while (getline(ss, item, ',')) {
+        sizes.push_back(parseSize(item));
+    }
+    if (sizes.empty()) {
+        throw invalid_argument("empty size list");
+    }
+    return sizes;
+}
+
+vector<BenchTarget> benchTargets() {
+    vector<BenchTarget> targets;
+    targets.push_back({ "dd/SHA512", 1, [](const string& m, uint8* out) {
+        SHA512 sha512;
+        sha512.update(reinterpret_cast<const uint8*>(m.data()), m.size());
+        sha512.final(out);
+    } });
+    targets.push_back({ "dd/SHA384", 1, [](const string& m, uint8* out) {
+        SHA384 sha384;
+        sha384.update(reinterpret_cast<const uint8*>(m.data()), m.size());
+        sha384.final(out);
+    } });
+    targets.push_back({ "dd/MD5", 1, [](const string& m, uint8* out) {
+        MD5 md5;
+        md5.update(reinterpret_cast<const uint8*>(m.data()), m.size());
+        md5.final(out);
+    } });
+
+    // One call submits the same message once per lane
+    size_t shaLanes = SHA512Lanes::supportedLanes(SHA512Lanes::MAX_LANES);
+    targets.push_back({ "dd/SHA512-multibuffer", shaLanes, [shaLanes](const string& m, uint8* out) {
+        static SHA512MultiBuffer engine;
+        for (size_t i = 0; i < shaLanes; i++) {
+            engine.submit(reinterpret_cast<const uint8*>(m.data()), m.size(), out + i * 64);
+        }
+        engine.flush();
+    } });
+    size_t md5Lanes = MD5Lanes::supportedLanes(MD5Lanes::MAX_LANES);
+    targets.push_back({ "dd/MD5-multibuffer", md5Lanes, [md5Lanes](const string& m, uint8* out) {
+        static MD5MultiBuffer engine;
+        for (size_t i = 0; i < md5Lanes; i++) {
+            engine.submit(reinterpret_cast<const uint8*>(m.data()), m.size(), out + i * 16);
+        }
+        engine.flush();
+    } });
+
+    // dd1 returns hex strings; keep a byte so the call cannot be dropped
+    targets.push_back({ "dd1/sha512", 1, [](const string& m, uint8* out) {
+        out[0] = (uint8)CryptoAlgorithms::sha512(m)[0];
+    } });
+    targets.push_back({ "dd1/md5", 1, [](const string& m, uint8* out) {
+        out[0] = (uint8)CryptoAlgorithms::md5(m)[0];
+    } });
+
+    targets.push_back({ "SHA512.cpp/SHA256-" + SHA256::backend(), 1, [](const string& m, uint8* out) {
+        SHA256 sha256;
+        sha256.update(reinterpret_cast<const uint8_t*>(m.data()), m.size());
+        sha256.final(out);
+    } });
+    return targets;
+}
+
+// Time target on message: warm up, calibrate, keep the fastest trial
+BenchResult measure(const BenchTarget& target, const string& message, double minTime, int repeat) {
+    static uint8 digests[64 * MD5_MAX_LANES];
+    target.run(message, digests);
+
+    size_t iterations = 1;
+    while (true) {
+        auto start = chrono::steady_clock::now();
+        for (size_t i = 0; i < iterations; i++) {
+            target.run(message, digests);
+        }
+        double elapsed = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        if (elapsed >= minTime / 4 || iterations >= (1ULL << 40)) {
+            iterations = max<size_t>(1, (size_t)(iterations * minTime / max(elapsed, 1e-9)));
+            break;
+        }
+        double growth = elapsed > 0 ? min(10.0, max(2.0, minTime / 4 / elapsed)) : 10.0;
+        iterations = (size_t)(iterations * growth);
+    }
+
+    BenchResult best = { target.name, message.size(), iterations * target.messagesPerCall, 0, 0 };
+    for (int trial = 0; trial < repeat; trial++) {
+        auto start = chrono::steady_clock::now();
+        uint64 startCycles = readCycles();
+        for (size_t i = 0; i < iterations; i++) {
+            target.run(message, digests);
+        }
+        uint64 cycles = readCycles() - startCycles;
+        double elapsed = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        if (trial == 0 || elapsed < best.seconds) {
+            best.seconds = elapsed;
+            best.cycles = (double)cycles;
+        }
+    }
+    return best;
+}
+
+void printResult(ostream& out, const string& format, const BenchResult& r, bool first) {
+    double perMessage = r.seconds / r.messages;
+    double cyclesPerMessage = r.cycles / r.messages;
+    double megabytes = r.size * r.messages / r.seconds / 1e6;
+    if (format == "csv") {
+        if (first) {
+            out << "implementation,size,messages,seconds,ns_per_msg,msgs_per_s,mb_per_s,cycles_per_msg,cycles_per_byte" << "\n";
+        }
+        out << r.name << "," << r.size << "," << r.messages << "," << setprecision(6) << r.seconds << ","
+            << perMessage * 1e9 << "," << 1 / perMessage << "," << megabytes << ","
+            << cyclesPerMessage << ",";
+        if (r.size > 0) {
+            out << cyclesPerMessage / r.size;
+        }
+        out << "\n";
+    } else if (format == "json") {
+        out << (first ? "[\n" : ",\n") << "  {\"implementation\": \"" << r.name << "\", \"size\": " << r.size
+            << ", \"messages\": " << r.messages << ", \"seconds\": " << setprecision(6) << r.seconds
+            << ", \"ns_per_msg\": " << perMessage * 1e9 << ", \"msgs_per_s\": " << 1 / perMessage
+            << ", \"mb_per_s\": " << megabytes << ", \"cycles_per_msg\": " << cyclesPerMessage
+            << ", \"cycles_per_byte\": ";
+        if (r.size > 0) {
+            out << cyclesPerMessage / r.size;
+        } else {
+            out << "null";
+        }
+        out << "}";
+    } else {
+        if (first) {
+            out << left << setw(32) << "implementation" << right << setw(12) << "size" << setw(14) << "msgs/s"
+                << setw(12) << "MB/s" << setw(14) << "cycles/msg" << setw(12) << "cycles/B" << "\n";
+        }
+        // Large messages run at a few per second; keep their rate readable
+        out << left << setw(32) << r.name << right << setw(12) << r.size << fixed
+            << setprecision(1 / perMessage < 100 ? 2 : 0) << setw(14) << 1 / perMessage << setprecision(1) << setw(12) << megabytes
+            << setprecision(0) << setw(14) << cyclesPerMessage << setprecision(2) << setw(12);
+        if (r.size > 0) {
+            out << cyclesPerMessage / r.size;
+        } else {
+            out << "-";
+        }
+        out << "\n";
+        out.unsetf(ios::floatfield);
+    }
+}
+
+void printBenchUsage(const char* program) {
+    cerr << "Usage: " << program << " [--sizes LIST] [--filter TEXT] [--min-time SEC] [--repeat N]" << endl;
+    cerr << "       " << "[--cpu N] [--format table|csv|json] [--output FILE]" << endl;
+    cerr << "LIST is comma-separated sizes with optional K/M/G suffix (default 0,64,1K,16K,1M,64M,1G)" << endl;
+}
+
+int main(int argc, char* argv[]) {
+    vector<size_t> sizes;
+    string filter, format = "table", outputPath;
+    double minTime = 0.2;
+    int repeat = 3, cpu = 0;
+    try {
+        sizes = parseSizeList("0,64,1K,16K,1M,64M,1G");
+        for (int i = 1; i < argc; i++) {
+            string option = argv[i];
+            if (i + 1 >= argc) {
+                throw invalid_argument("missing value for " + option);
+            }
+            string value = argv[++i];
+            if (option == "--sizes") {
+                sizes = parseSizeList(value);
+            } else if (option == "--filter") {
+                filter = value;
+            } else if (option == "--min-time") {
+                minTime = stod(value);
+            } else if (option == "--repeat") {
+                repeat = (int)parseCount(option, value);
+            } else if (option == "--cpu") {
+                cpu = stoi(value);
+            } else if (option == "--format" && (value == "table" || value == "csv" || value == "json")) {
+                format = value;
+            } else if (option == "--output") {
+                outputPath = value;
+            } else {
+                throw invalid_argument("unknown option " + option + " " + value);
+            }
+        }
+    } catch (const exception& e) {
+        cerr << "Error: " << e.what() << endl;
+        printBenchUsage(argv[0]);
+        return 2;
+    }
+
+    // Pin to one CPU so the scheduler does not migrate the measurement;
+    // a negative --cpu leaves the affinity alone
+    if (cpu >= 0) {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(cpu, &set);
+        if (sched_setaffinity(0, sizeof(set), &set) != 0) {
+            cerr << "Warning: cannot pin to CPU " << cpu << ": " << strerror(errno) << endl;
+        }
+    }
+
+    ofstream file;
+    if (!outputPath.empty()) {
+        file.open(outputPath);
+        if (!file) {
+            cerr << "Error: cannot write " << outputPath << endl;
+            return 1;
+        }
+    }
+    ostream& out = outputPath.empty() ? cout : file;
+
+    vector<BenchTarget> targets = benchTargets();
+    bool first = true;
+    for (size_t size : sizes) {
+        string message(size, '\0');
+        for (size_t i = 0; i < size; i++) {
+            message[i] = (char)(i * 131 + (i >> 8));
+        }
+        for (const BenchTarget& target : targets) {
+            if (!filter.empty() && target.name.find(filter) == string::npos) {
+                continue;
+            }
+            printResult(out, format, measure(target, message, minTime, repeat), first);
+            first = false;
+            out.flush();
+        }
+    }
+    if (format == "json" && !first) {
+        out << "\n]\n";
+    }
+    return 0;
+}
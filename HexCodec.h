@@ -0,0 +1,229 @@
+#ifndef HEX_CODEC_H
+#define HEX_CODEC_H
+
+// Hex and bit-string ('0'/'1') conversion shared by the cipher and hash programs.
+// Bulk work runs 16 bytes at a time with SSSE3 when the CPU has it; short
+// tails and other CPUs use the scalar loops. Decoders validate their input
+// and throw invalid_argument on anything that is not a hex digit or a bit.
+
+#include <string>
+#include <vector>
+#include <stdexcept>
+#include <cstdint>
+#include <cstddef>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define HEX_CODEC_SIMD 1
+#endif
+
+namespace hexcodec {
+
+inline int nibbleValue(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+inline char nibbleDigit(int value, bool uppercase) {
+    return (char)(value < 10 ? '0' + value : (uppercase ? 'A' : 'a') + value - 10);
+}
+
+inline bool hasSSSE3() {
+#ifdef HEX_CODEC_SIMD
+    static const bool supported = (__builtin_cpu_init(), __builtin_cpu_supports("ssse3"));
+    return supported;
+#else
+    return false;
+#endif
+}
+
+#ifdef HEX_CODEC_SIMD
+// 16 bytes -> 32 hex digits
+__attribute__((target("ssse3")))
+inline void encode16(const uint8_t* in, char* out, bool uppercase) {
+    const __m128i digits = uppercase ? _mm_setr_epi8('0', '1', '2', '3', '4', '5', '6', '7', '8', '9', 'A', 'B', 'C', 'D', 'E', 'F')
+                                     : _mm_setr_epi8('0', '1', '2', '3', '4', '5', '6', '7', '8', '9', 'a', 'b', 'c', 'd', 'e', 'f');
+    const __m128i lowMask = _mm_set1_epi8(0x0f);
+    __m128i bytes = _mm_loadu_si128((const __m128i*)in);
+    __m128i high = _mm_shuffle_epi8(digits, _mm_and_si128(_mm_srli_epi16(bytes, 4), lowMask));
+    __m128i low = _mm_shuffle_epi8(digits, _mm_and_si128(bytes, lowMask));
+    _mm_storeu_si128((__m128i*)out, _mm_unpacklo_epi8(high, low));
+    _mm_storeu_si128((__m128i*)(out + 16), _mm_unpackhi_epi8(high, low));
+}
+
+// 32 hex digits -> 16 bytes; returns false if any character is not a hex digit
+__attribute__((target("ssse3")))
+inline bool decode16(const char* in, uint8_t* out) {
+    for (int half = 0; half < 2; half++) {
+        __m128i chars = _mm_loadu_si128((const __m128i*)(in + half * 16));
+        // '0'..'9' -> 0..9
+        __m128i digit = _mm_sub_epi8(chars, _mm_set1_epi8('0'));
+        __m128i isDigit = _mm_and_si128(_mm_cmpgt_epi8(chars, _mm_set1_epi8('0' - 1)),
+                                        _mm_cmplt_epi8(chars, _mm_set1_epi8('9' + 1)));
+        // 'a'..'f' and 'A'..'F' -> 10..15
+        __m128i folded = _mm_or_si128(chars, _mm_set1_epi8(0x20));
+        __m128i letter = _mm_sub_epi8(folded, _mm_set1_epi8('a' - 10));
+        __m128i isLetter = _mm_and_si128(_mm_cmpgt_epi8(folded, _mm_set1_epi8('a' - 1)),
+                                         _mm_cmplt_epi8(folded, _mm_set1_epi8('f' + 1)));
+        if (_mm_movemask_epi8(_mm_or_si128(isDigit, isLetter)) != 0xffff) {
+            return false;
+        }
+        __m128i values = _mm_or_si128(_mm_and_si128(isDigit, digit), _mm_and_si128(isLetter, letter));
+        // Each pair (high, low) -> high * 16 + low
+        __m128i pairs = _mm_maddubs_epi16(values, _mm_set1_epi16(0x0110));
+        __m128i packed = _mm_packus_epi16(pairs, pairs);
+        _mm_storel_epi64((__m128i*)(out + half * 8), packed);
+    }
+    return true;
+}
+
+// 2 bytes -> 16 bit characters, most significant bit first
+__attribute__((target("ssse3")))
+inline void bits16(const uint8_t* in, char* out) {
+    __m128i bytes = _mm_set1_epi16((short)(in[0] | (in[1] << 8)));
+    __m128i spread = _mm_shuffle_epi8(bytes, _mm_setr_epi8(0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1));
+    const __m128i masks = _mm_setr_epi8((char)0x80, 0x40, 0x20, 0x10, 0x08, 0x04, 0x02, 0x01,
+                                        (char)0x80, 0x40, 0x20, 0x10, 0x08, 0x04, 0x02, 0x01);
+    __m128i set = _mm_cmpeq_epi8(_mm_and_si128(spread, masks), masks);
+    __m128i chars = _mm_add_epi8(_mm_set1_epi8('0'), _mm_and_si128(set, _mm_set1_epi8(1)));
+    _mm_storeu_si128((__m128i*)out, chars);
+}
+
+// 16 bit characters -> 2 bytes; returns false on anything but '0'/'1'
+__attribute__((target("ssse3")))
+inline bool unbits16(const char* in, uint8_t* out) {
+    __m128i chars = _mm_loadu_si128((const __m128i*)in);
+    __m128i ones = _mm_cmpeq_epi8(chars, _mm_set1_epi8('1'));
+    __m128i zeros = _mm_cmpeq_epi8(chars, _mm_set1_epi8('0'));
+    if (_mm_movemask_epi8(_mm_or_si128(ones, zeros)) != 0xffff) {
+        return false;
+    }
+    // movemask puts character 0 in bit 0; reverse each group of eight so the
+    // first character of each byte lands in its most significant bit
+    __m128i reversed = _mm_shuffle_epi8(ones, _mm_setr_epi8(7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8));
+    int mask = _mm_movemask_epi8(reversed);
+    out[0] = (uint8_t)(mask & 0xff);
+    out[1] = (uint8_t)(mask >> 8);
+    return true;
+}
+#endif
+
+} // namespace hexcodec
+
+// Bytes -> hex digits (lowercase unless asked otherwise)
+inline std::string hexEncode(const uint8_t* data, size_t length, bool uppercase = false) {
+    std::string out(length * 2, '0');
+    size_t i = 0;
+#ifdef HEX_CODEC_SIMD
+    if (hexcodec::hasSSSE3()) {
+        for (; i + 16 <= length; i += 16) {
+            hexcodec::encode16(data + i, &out[i * 2], uppercase);
+        }
+    }
+#endif
+    for (; i < length; i++) {
+        out[i * 2] = hexcodec::nibbleDigit(data[i] >> 4, uppercase);
+        out[i * 2 + 1] = hexcodec::nibbleDigit(data[i] & 0x0f, uppercase);
+    }
+    return out;
+}
+
+inline std::string hexEncode(const std::vector<unsigned char>& bytes, bool uppercase = false) {
+    return hexEncode(bytes.data(), bytes.size(), uppercase);
+}
+
+// Hex digits -> bytes; the digit count must be even
+inline std::vector<unsigned char> hexDecode(const std::string& hex) {
+    if (hex.size() % 2 != 0) {
+        throw std::invalid_argument("Hex string must have an even number of digits");
+    }
+    std::vector<unsigned char> out(hex.size() / 2);
+    size_t i = 0;
+#ifdef HEX_CODEC_SIMD
+    if (hexcodec::hasSSSE3()) {
+        for (; i + 16 <= out.size(); i += 16) {
+            if (!hexcodec::decode16(&hex[i * 2], &out[i])) {
+                throw std::invalid_argument("Invalid hexadecimal digit");
+            }
+        }
+    }
+#endif
+    for (; i < out.size(); i++) {
+        int high = hexcodec::nibbleValue(hex[i * 2]);
+        int low = hexcodec::nibbleValue(hex[i * 2 + 1]);
+        if (high < 0 || low < 0) {
+            throw std::invalid_argument("Invalid hexadecimal digit");
+        }
+        out[i] = (unsigned char)((high << 4) | low);
+    }
+    return out;
+}
+
+// Hex digits -> bit string, four bits per digit (odd digit counts allowed)
+inline std::string hexToBitString(const std::string& hex) {
+    std::string out(hex.size() * 4, '0');
+    size_t digit = 0;
+#ifdef HEX_CODEC_SIMD
+    if (hexcodec::hasSSSE3()) {
+        uint8_t bytes[16];
+        for (; digit + 32 <= hex.size(); digit += 32) {
+            if (!hexcodec::decode16(&hex[digit], bytes)) {
+                throw std::invalid_argument("Invalid hexadecimal digit");
+            }
+            for (int j = 0; j < 16; j += 2) {
+                hexcodec::bits16(bytes + j, &out[digit * 4 + j * 8]);
+            }
+        }
+    }
+#endif
+    for (; digit < hex.size(); digit++) {
+        int value = hexcodec::nibbleValue(hex[digit]);
+        if (value < 0) {
+            throw std::invalid_argument("Invalid hexadecimal digit");
+        }
+        for (int bit = 0; bit < 4; bit++) {
+            out[digit * 4 + bit] = (char)('0' + ((value >> (3 - bit)) & 1));
+        }
+    }
+    return out;
+}
+
+// Bit string -> hex digits; the length must be a multiple of four
+inline std::string bitStringToHex(const std::string& bits, bool uppercase = false) {
+    if (bits.size() % 4 != 0) {
+        throw std::invalid_argument("Bit string length must be a multiple of 4");
+    }
+    std::string out(bits.size() / 4, '0');
+    size_t bit = 0;
+#ifdef HEX_CODEC_SIMD
+    if (hexcodec::hasSSSE3()) {
+        uint8_t bytes[16];
+        char digits[32];
+        for (; bit + 128 <= bits.size(); bit += 128) {
+            for (int j = 0; j < 16; j += 2) {
+                if (!hexcodec::unbits16(&bits[bit + j * 8], bytes + j)) {
+                    throw std::invalid_argument("Bit string may only contain '0' and '1'");
+                }
+            }
+            hexcodec::encode16(bytes, digits, uppercase);
+            out.replace(bit / 4, 32, digits, 32);
+        }
+    }
+#endif
+    for (; bit < bits.size(); bit += 4) {
+        int value = 0;
+        for (int j = 0; j < 4; j++) {
+            char c = bits[bit + j];
+            if (c != '0' && c != '1') {
+                throw std::invalid_argument("Bit string may only contain '0' and '1'");
+            }
+            value = (value << 1) | (c - '0');
+        }
+        out[bit / 4] = hexcodec::nibbleDigit(value, uppercase);
+    }
+    return out;
+}
+
+#endif
@@ -2,6 +2,7 @@
 #include <vector>
 #include <string>
 #include <algorithm>
+#include "HexCodec.h"
 
 class RC4 {
 private:
@@ -49,11 +50,11 @@ public:
 
 // Helper function to print hex
 void print_hex(const std::vector<unsigned char>& data) {
-    for (unsigned char byte : data) {
-        std::cout << std::hex << std::setw(2) << std::setfill('0')
-                  << static_cast<int>(byte) << " ";
+    std::string digits = hexEncode(data);
+    for (size_t i = 0; i < digits.size(); i += 2) {
+        std::cout << digits.substr(i, 2) << " ";
     }
-    std::cout << std::dec << std::endl;
+    std::cout << std::endl;
 }
 
 int main() {
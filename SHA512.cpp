@@ -4,6 +4,16 @@
 #include <cstdint>
 #include <string>
 #include <sstream>
+#include <vector>
+#include <cstring>
+#include <algorithm>
+#include "HexCodec.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#include <cpuid.h>
+#define HAVE_X86_SIMD 1
+#endif
 
 using namespace std;
 
@@ -35,6 +45,15 @@ static uint32_t sigma1_32(uint32_t x) {
     return rotr32(x, 6) ^ rotr32(x, 11) ^ rotr32(x, 25);
 }
 
+// SHA-256 message schedule sigma functions
+static uint32_t smallSigma0_32(uint32_t x) {
+    return rotr32(x, 7) ^ rotr32(x, 18) ^ (x >> 3);
+}
+
+static uint32_t smallSigma1_32(uint32_t x) {
+    return rotr32(x, 17) ^ rotr32(x, 19) ^ (x >> 10);
+}
+
 // SHA-512 sigma functions
 static uint64_t sigma0_64(uint64_t x) {
     return rotr64(x, 28) ^ rotr64(x, 34) ^ rotr64(x, 39);
@@ -44,6 +63,369 @@ static uint64_t sigma1_64(uint64_t x) {
     return rotr64(x, 14) ^ rotr64(x, 18) ^ rotr64(x, 41);
 }
 
+// SHA-256 round constants
+static const uint32_t SHA256_K[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+// SHA-256 initial hash values
+static const uint32_t SHA256_IV[8] = {
+    0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
+};
+
+static uint32_t loadBigEndian32(const uint8_t* p) {
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+// Portable SHA-256 compression of consecutive 64-byte blocks, built from
+// the helper functions above
+static void sha256CompressScalar(uint32_t state[8], const uint8_t* data, size_t blocks) {
+    for (; blocks > 0; blocks--, data += 64) {
+        uint32_t w[64];
+        for (int t = 0; t < 16; t++) {
+            w[t] = loadBigEndian32(data + t * 4);
+        }
+        for (int t = 16; t < 64; t++) {
+            w[t] = smallSigma1_32(w[t-2]) + w[t-7] + smallSigma0_32(w[t-15]) + w[t-16];
+        }
+
+        uint32_t a = state[0], b = state[1], c = state[2], d = state[3];
+        uint32_t e = state[4], f = state[5], g = state[6], h = state[7];
+        for (int t = 0; t < 64; t++) {
+            uint32_t T1 = h + sigma1_32(e) + ch(e, f, g) + SHA256_K[t] + w[t];
+            uint32_t T2 = sigma0_32(a) + maj(a, b, c);
+            h = g;
+            g = f;
+            f = e;
+            e = d + T1;
+            d = c;
+            c = b;
+            b = a;
+            a = T1 + T2;
+        }
+
+        state[0] += a; state[1] += b; state[2] += c; state[3] += d;
+        state[4] += e; state[5] += f; state[6] += g; state[7] += h;
+    }
+}
+
+#ifdef HAVE_X86_SIMD
+// SHA-256 using the x86 SHA extensions. The state is kept in the
+// ABEF/CDGH register layout that SHA256RNDS2 expects; each iteration of
+// the loop performs four rounds and extends the schedule by four words.
+__attribute__((target("sha,ssse3,sse4.1")))
+static void sha256CompressSHANI(uint32_t state[8], const uint8_t* data, size_t blocks) {
+    const __m128i byteSwap = _mm_set_epi64x(0x0c0d0e0f08090a0bULL, 0x0405060700010203ULL);
+
+    __m128i tmp = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i*)&state[0]), 0xB1);  // CDAB
+    __m128i state1 = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i*)&state[4]), 0x1B);  // EFGH
+    __m128i state0 = _mm_alignr_epi8(tmp, state1, 8);  // ABEF
+    state1 = _mm_blend_epi16(state1, tmp, 0xF0);  // CDGH
+
+    for (; blocks > 0; blocks--, data += 64) {
+        __m128i abefSave = state0, cdghSave = state1;
+        __m128i w[4];
+
+#pragma GCC unroll 16
+        for (int i = 0; i < 16; i++) {
+            if (i < 4) {
+                w[i] = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(data + i * 16)), byteSwap);
+            } else {
+                // w[i & 3] still holds words 4i-16..4i-13 from four iterations ago
+                __m128i next = _mm_sha256msg1_epu32(w[i & 3], w[(i + 1) & 3]);
+                next = _mm_add_epi32(next, _mm_alignr_epi8(w[(i + 3) & 3], w[(i + 2) & 3], 4));
+                w[i & 3] = _mm_sha256msg2_epu32(next, w[(i + 3) & 3]);
+            }
+            __m128i msg = _mm_add_epi32(w[i & 3], _mm_loadu_si128((const __m128i*)&SHA256_K[i * 4]));
+            state1 = _mm_sha256rnds2_epu32(state1, state0, msg);
+            state0 = _mm_sha256rnds2_epu32(state0, state1, _mm_shuffle_epi32(msg, 0x0E));
+        }
+
+        state0 = _mm_add_epi32(state0, abefSave);
+        state1 = _mm_add_epi32(state1, cdghSave);
+    }
+
+    tmp = _mm_shuffle_epi32(state0, 0x1B);  // FEBA
+    state1 = _mm_shuffle_epi32(state1, 0xB1);  // DCHG
+    state0 = _mm_blend_epi16(tmp, state1, 0xF0);  // DCBA
+    state1 = _mm_alignr_epi8(state1, tmp, 8);  // HGFE
+    _mm_storeu_si128((__m128i*)&state[0], state0);
+    _mm_storeu_si128((__m128i*)&state[4], state1);
+}
+
+#define ROTR32_AVX2(x, n) _mm256_or_si256(_mm256_srli_epi32((x), (n)), _mm256_slli_epi32((x), 32 - (n)))
+
+// Eight independent SHA-256 compressions, one per 32-bit AVX2 lane.
+// state is transposed: state[word][lane].
+__attribute__((target("avx2")))
+static void sha256CompressAVX2x8(uint32_t state[8][8], const uint8_t* const blocks[8]) {
+    __m256i w[16];
+    __m256i v[8];
+    for (int i = 0; i < 8; i++) {
+        v[i] = _mm256_loadu_si256((const __m256i*)state[i]);
+    }
+    __m256i a = v[0], b = v[1], c = v[2], d = v[3], e = v[4], f = v[5], g = v[6], h = v[7];
+
+    for (int t = 0; t < 64; t++) {
+        __m256i wt;
+        if (t < 16) {
+            wt = _mm256_set_epi32(loadBigEndian32(blocks[7] + t * 4), loadBigEndian32(blocks[6] + t * 4),
+                                  loadBigEndian32(blocks[5] + t * 4), loadBigEndian32(blocks[4] + t * 4),
+                                  loadBigEndian32(blocks[3] + t * 4), loadBigEndian32(blocks[2] + t * 4),
+                                  loadBigEndian32(blocks[1] + t * 4), loadBigEndian32(blocks[0] + t * 4));
+        } else {
+            __m256i w2 = w[(t - 2) & 15], w15 = w[(t - 15) & 15];
+            __m256i s0 = _mm256_xor_si256(_mm256_xor_si256(ROTR32_AVX2(w15, 7), ROTR32_AVX2(w15, 18)), _mm256_srli_epi32(w15, 3));
+            __m256i s1 = _mm256_xor_si256(_mm256_xor_si256(ROTR32_AVX2(w2, 17), ROTR32_AVX2(w2, 19)), _mm256_srli_epi32(w2, 10));
+            wt = _mm256_add_epi32(_mm256_add_epi32(w[t & 15], s0), _mm256_add_epi32(w[(t - 7) & 15], s1));
+        }
+        w[t & 15] = wt;
+
+        __m256i S1 = _mm256_xor_si256(_mm256_xor_si256(ROTR32_AVX2(e, 6), ROTR32_AVX2(e, 11)), ROTR32_AVX2(e, 25));
+        __m256i chv = _mm256_xor_si256(_mm256_and_si256(e, f), _mm256_andnot_si256(e, g));
+        __m256i T1 = _mm256_add_epi32(_mm256_add_epi32(h, S1),
+                                      _mm256_add_epi32(_mm256_add_epi32(chv, _mm256_set1_epi32(SHA256_K[t])), wt));
+        __m256i S0 = _mm256_xor_si256(_mm256_xor_si256(ROTR32_AVX2(a, 2), ROTR32_AVX2(a, 13)), ROTR32_AVX2(a, 22));
+        __m256i majv = _mm256_or_si256(_mm256_and_si256(a, b), _mm256_and_si256(c, _mm256_or_si256(a, b)));
+        __m256i T2 = _mm256_add_epi32(S0, majv);
+        h = g;
+        g = f;
+        f = e;
+        e = _mm256_add_epi32(d, T1);
+        d = c;
+        c = b;
+        b = a;
+        a = _mm256_add_epi32(T1, T2);
+    }
+
+    v[0] = a; v[1] = b; v[2] = c; v[3] = d; v[4] = e; v[5] = f; v[6] = g; v[7] = h;
+    for (int i = 0; i < 8; i++) {
+        _mm256_storeu_si256((__m256i*)state[i], _mm256_add_epi32(_mm256_loadu_si256((const __m256i*)state[i]), v[i]));
+    }
+}
+#endif
+
+// CPU feature checks, done once
+static bool cpuHasSHANI() {
+#ifdef HAVE_X86_SIMD
+    unsigned int eax, ebx, ecx, edx;
+    if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx) || !(ecx & bit_SSE4_1) || !(ecx & bit_SSSE3)) {
+        return false;
+    }
+    if (!__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx)) {
+        return false;
+    }
+    return (ebx & bit_SHA) != 0;
+#else
+    return false;
+#endif
+}
+
+static bool cpuHasAVX2() {
+#ifdef HAVE_X86_SIMD
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2");
+#else
+    return false;
+#endif
+}
+
+// SHA-256 with a streaming interface. The block function is picked once
+// at startup: the SHA extensions when the CPU has them, else the portable code.
+class SHA256 {
+private:
+    typedef void (*CompressFunction)(uint32_t state[8], const uint8_t* data, size_t blocks);
+
+    uint32_t h[8];
+    uint8_t buffer[64];
+    size_t bufferLength;
+    uint64_t length;
+
+    static CompressFunction selectCompress() {
+#ifdef HAVE_X86_SIMD
+        if (cpuHasSHANI()) {
+            return sha256CompressSHANI;
+        }
+#endif
+        return sha256CompressScalar;
+    }
+
+    static CompressFunction compress() {
+        static const CompressFunction selected = selectCompress();
+        return selected;
+    }
+
+    // Build the padded final block(s) for a message tail; returns the block count
+    static size_t padTail(const uint8_t* tail, size_t tailLength, uint64_t messageLength, uint8_t out[128]) {
+        size_t blocks = tailLength < 56 ? 1 : 2;
+        memset(out, 0, blocks * 64);
+        memcpy(out, tail, tailLength);
+        out[tailLength] = 0x80;
+        uint64_t bits = messageLength << 3;
+        for (int i = 0; i < 8; i++) {
+            out[blocks * 64 - 1 - i] = (bits >> (i * 8)) & 0xFF;
+        }
+        return blocks;
+    }
+
+    static void encodeDigest(const uint32_t state[8], uint8_t digest[32]) {
+        for (int i = 0; i < 32; i++) {
+            digest[i] = (state[i / 4] >> (24 - (i % 4) * 8)) & 0xFF;
+        }
+    }
+
+    static string toHex(const uint8_t* data, size_t count) {
+        return hexEncode(data, count);
+    }
+
+public:
+    SHA256() {
+        reset();
+    }
+
+    // Name of the block function in use
+    static string backend() {
+        return compress() == sha256CompressScalar ? "portable" : "SHA extensions";
+    }
+
+    void reset() {
+        memcpy(h, SHA256_IV, sizeof(h));
+        bufferLength = 0;
+        length = 0;
+    }
+
+    void update(const uint8_t* data, size_t count) {
+        length += count;
+        if (bufferLength > 0) {
+            size_t take = min(count, (size_t)64 - bufferLength);
+            memcpy(buffer + bufferLength, data, take);
+            bufferLength += take;
+            data += take;
+            count -= take;
+            if (bufferLength < 64) {
+                return;
+            }
+            compress()(h, buffer, 1);
+            bufferLength = 0;
+        }
+
+        // Hand every whole block to the block function in one call
+        if (count >= 64) {
+            compress()(h, data, count / 64);
+            data += count & ~(size_t)63;
+            count &= 63;
+        }
+        memcpy(buffer, data, count);
+        bufferLength = count;
+    }
+
+    void update(const string& input) {
+        update(reinterpret_cast<const uint8_t*>(input.data()), input.size());
+    }
+
+    void final(uint8_t digest[32]) {
+        uint8_t tail[128];
+        size_t blocks = padTail(buffer, bufferLength, length, tail);
+        compress()(h, tail, blocks);
+        encodeDigest(h, digest);
+        bufferLength = 0;
+    }
+
+    string hash(const string& input) {
+        reset();
+        update(input);
+        uint8_t digest[32];
+        final(digest);
+        return toHex(digest, 32);
+    }
+
+    // Multi-buffer batch hashing. With the SHA extensions (or without AVX2)
+    // each message goes through the streaming path; otherwise messages are
+    // hashed eight at a time, one per AVX2 lane, which pays off for many
+    // short messages.
+    static vector<string> hashBatch(const vector<string>& messages) {
+#ifdef HAVE_X86_SIMD
+        if (!cpuHasSHANI() && cpuHasAVX2()) {
+            return hashBatchAVX2(messages);
+        }
+#endif
+        vector<string> digests(messages.size());
+        SHA256 sha256;
+        for (size_t i = 0; i < messages.size(); i++) {
+            digests[i] = sha256.hash(messages[i]);
+        }
+        return digests;
+    }
+
+#ifdef HAVE_X86_SIMD
+    static bool hasAVX2() {
+        return cpuHasAVX2();
+    }
+
+    // The AVX2 lanes whatever the backend, so they can be tested on hosts
+    // with the SHA extensions; needs hasAVX2()
+    static vector<string> hashBatchAVX2(const vector<string>& messages) {
+        vector<string> digests(messages.size());
+        static const uint8_t idleBlock[64] = { 0 };
+        for (size_t first = 0; first < messages.size(); first += 8) {
+            size_t lanes = min<size_t>(8, messages.size() - first);
+            uint32_t state[8][8];
+            uint8_t tails[8][128];
+            size_t fullBlocks[8] = { 0 }, totalBlocks[8] = { 0 }, maxBlocks = 0;
+
+            for (size_t lane = 0; lane < lanes; lane++) {
+                const string& message = messages[first + lane];
+                fullBlocks[lane] = message.size() / 64;
+                totalBlocks[lane] = fullBlocks[lane]
+                    + padTail(reinterpret_cast<const uint8_t*>(message.data()) + fullBlocks[lane] * 64,
+                              message.size() % 64, message.size(), tails[lane]);
+                maxBlocks = max(maxBlocks, totalBlocks[lane]);
+            }
+            for (int word = 0; word < 8; word++) {
+                for (int lane = 0; lane < 8; lane++) {
+                    state[word][lane] = SHA256_IV[word];
+                }
+            }
+
+            // Lanes whose message is done keep running on an idle block;
+            // their digests are captured as soon as they finish
+            for (size_t block = 0; block < maxBlocks; block++) {
+                const uint8_t* blocks[8];
+                for (size_t lane = 0; lane < 8; lane++) {
+                    if (lane >= lanes || block >= totalBlocks[lane]) {
+                        blocks[lane] = idleBlock;
+                    } else if (block < fullBlocks[lane]) {
+                        blocks[lane] = reinterpret_cast<const uint8_t*>(messages[first + lane].data()) + block * 64;
+                    } else {
+                        blocks[lane] = tails[lane] + (block - fullBlocks[lane]) * 64;
+                    }
+                }
+                sha256CompressAVX2x8(state, blocks);
+                for (size_t lane = 0; lane < lanes; lane++) {
+                    if (block + 1 == totalBlocks[lane]) {
+                        uint32_t laneState[8];
+                        uint8_t digest[32];
+                        for (int word = 0; word < 8; word++) {
+                            laneState[word] = state[word][lane];
+                        }
+                        encodeDigest(laneState, digest);
+                        digests[first + lane] = toHex(digest, 32);
+                    }
+                }
+            }
+        }
+        return digests;
+    }
+#endif
+};
+
 // Function to get numeric input from user
 template<typename T>
 T getInput(const string& prompt) {
@@ -85,6 +467,60 @@ void printHex(uint64_t value, int bits = 64) {
     cout << "Hex: 0x" << hex << setw(digits) << setfill('0') << value << dec << endl;
 }
 
+// Check SHA-256 against the FIPS 180-4 examples, and the batch paths
+// against hash() on every length across the one- and two-block padding cases
+void runSHA256SelfTest() {
+    const pair<string, string> vectors[] = {
+        { "", "e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855" },
+        { "abc", "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad" },
+        { "abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq",
+          "248d6a61d20638b8e5c026930c3e6039a33ce45964ff2167f6ecedd419db06c1" },
+        { string(1000000, 'a'), "cdc76e5c9914fb9281a1c7e284d73e67f1809a48a497200e046d39ccc7112cd0" },
+    };
+
+    cout << "\nSHA-256 backend: " << SHA256::backend() << endl;
+    vector<string> knownMessages;
+    for (const auto& v : vectors) {
+        knownMessages.push_back(v.first);
+    }
+    vector<string> batched = SHA256::hashBatch(knownMessages);
+#ifdef HAVE_X86_SIMD
+    vector<string> lanes = SHA256::hasAVX2() ? SHA256::hashBatchAVX2(knownMessages) : batched;
+#endif
+    SHA256 sha256;
+    for (size_t i = 0; i < knownMessages.size(); i++) {
+        string actual = sha256.hash(knownMessages[i]);
+        bool ok = actual == vectors[i].second && batched[i] == vectors[i].second;
+#ifdef HAVE_X86_SIMD
+        ok = ok && lanes[i] == vectors[i].second;
+#endif
+        cout << "Input: " << (knownMessages[i].size() > 64 ? to_string(knownMessages[i].size()) + " bytes" : "\"" + knownMessages[i] + "\"") << endl;
+        cout << "Expected: " << vectors[i].second << endl;
+        cout << "Actual:   " << actual << endl;
+        cout << "Result:   " << (ok ? "PASS" : "FAIL") << endl << endl;
+    }
+
+    // 301 messages, so the last group of eight lanes is partly idle
+    vector<string> messages;
+    for (size_t length = 0; length <= 300; length++) {
+        string message(length, '\0');
+        for (size_t i = 0; i < length; i++) {
+            message[i] = (char)(i * 31 + length);
+        }
+        messages.push_back(message);
+    }
+    vector<string> expected;
+    for (const string& message : messages) {
+        expected.push_back(sha256.hash(message));
+    }
+    cout << "Batch vs hash() on lengths 0-300: " << (SHA256::hashBatch(messages) == expected ? "PASS" : "FAIL") << endl;
+#ifdef HAVE_X86_SIMD
+    if (SHA256::hasAVX2()) {
+        cout << "AVX2 8-lane vs hash() on lengths 0-300: " << (SHA256::hashBatchAVX2(messages) == expected ? "PASS" : "FAIL") << endl;
+    }
+#endif
+}
+
 // Main menu
 void showMenu() {
     cout << "\nSHA-512 Helper Functions Simulator\n";
@@ -97,7 +533,9 @@ void showMenu() {
     cout << "6. SHA-256 Sigma1 (σ1)\n";
     cout << "7. SHA-512 Sigma0 (Σ0)\n";
     cout << "8. SHA-512 Sigma1 (Σ1)\n";
-    cout << "9. Exit\n";
+    cout << "9. SHA-256 Hash\n";
+    cout << "10. SHA-256 Self-Test\n";
+    cout << "11. Exit\n";
     cout << "--------------------------------\n";
     cout << "Enter your choice: ";
 }
@@ -107,7 +545,7 @@ int main() {
         showMenu();
         int choice = getInput<int>("");
 
-        if (choice == 9) break;
+        if (choice == 11) break;
 
         switch (choice) {
             case 1: {
@@ -230,6 +668,21 @@ int main() {
                 break;
             }
 
+            case 9: {
+                cout << "Enter message to hash: ";
+                string message;
+                getline(cin, message);
+
+                SHA256 sha256;
+                cout << "\nSHA-256 (" << SHA256::backend() << "):\n";
+                cout << "Hash:     " << sha256.hash(message) << endl;
+                break;
+            }
+
+            case 10:
+                runSHA256SelfTest();
+                break;
+
             default:
                 cout << "Invalid choice. Please try again.\n";
         }
@@ -7,6 +7,7 @@
 #include <sstream>
 #include <ctime>
 #include <cstdint>
+#include "HexCodec.h"
 
 class CryptoAlgorithms {
 private:
@@ -43,71 +44,44 @@ private:
         return rotr64(x, 14) ^ rotr64(x, 18) ^ rotr64(x, 41);
     }
 
-    // SHA-512 constants
-    static const uint64_t SHA512_K[80];
-
-    // MD5 constants
-    static const uint32_t MD5_K[64];
-    static const uint32_t MD5_S[64];
-
-public:
-    // SHA-512 Implementation
-    static std::string sha512(const std::string& input) {
-        // Initial hash values
-        std::vector<uint64_t> H = {
-            0x6a09e667f3bcc908ULL, 0xbb67ae8584caa73bULL,
-            0x3c6ef372fe94f82bULL, 0xa54ff53a5f1d36f1ULL,
-            0x510e527fade682d1ULL, 0x9b05688c2b3e6c1fULL,
-            0x1f83d9abfb41bd6bULL, 0x5be0cd19137e2179ULL
-        };
+    static uint64_t smallSigma0_64(uint64_t x) {
+        return rotr64(x, 1) ^ rotr64(x, 8) ^ (x >> 7);
+    }
 
-        // Preprocessing
-        std::vector<uint8_t> message(input.begin(), input.end());
-        uint64_t ml = message.size() * 8;
-        message.push_back(0x80);
+    static uint64_t smallSigma1_64(uint64_t x) {
+        return rotr64(x, 19) ^ rotr64(x, 61) ^ (x >> 6);
+    }
 
-        // Padding
-        while ((message.size() * 8 + 128) % 1024 != 0) {
-            message.push_back(0);
+    static uint64_t loadBigEndian64(const uint8_t* p) {
+        uint64_t value = 0;
+        for (int i = 0; i < 8; ++i) {
+            value = (value << 8) | p[i];
         }
+        return value;
+    }
 
-        // Append message length
-        for (int i = 7; i >= 0; --i) {
-            message.push_back((ml >> (i * 8)) & 0xFF);
+    // One SHA-512 compression. W[t & 15] holds the last 16 schedule words
+    // and is overwritten in place; with the loop unrolled the indices are
+    // constants and the window stays in registers
+    static void sha512Block(uint64_t H[8], const uint8_t* block) {
+        uint64_t W[16];
+        for (int t = 0; t < 16; ++t) {
+            W[t] = loadBigEndian64(block + t * 8);
         }
 
-        // Process message in 1024-bit blocks
-        for (size_t i = 0; i < message.size(); i += 128) {
-            std::vector<uint64_t> W(80, 0);
-
-            // Prepare message schedule
-            for (int t = 0; t < 16; ++t) {
-                W[t] = ((uint64_t)message[i + t*8] << 56) |
-                       ((uint64_t)message[i + t*8 + 1] << 48) |
-                       ((uint64_t)message[i + t*8 + 2] << 40) |
-                       ((uint64_t)message[i + t*8 + 3] << 32) |
-                       ((uint64_t)message[i + t*8 + 4] << 24) |
-                       ((uint64_t)message[i + t*8 + 5] << 16) |
-                       ((uint64_t)message[i + t*8 + 6] << 8) |
-                       ((uint64_t)message[i + t*8 + 7]);
-            }
-
-            // Extend message schedule
-            for (int t = 16; t < 80; ++t) {
-                uint64_t s0 = rotr64(W[t-15], 1) ^ rotr64(W[t-15], 8) ^ (W[t-15] >> 7);
-                uint64_t s1 = rotr64(W[t-2], 19) ^ rotr64(W[t-2], 61) ^ (W[t-2] >> 6);
-                W[t] = W[t-16] + s0 + W[t-7] + s1;
-            }
+        // Working variables
+        uint64_t a = H[0], b = H[1], c = H[2], d = H[3],
+                 e = H[4], f = H[5], g = H[6], h = H[7];
 
-            // Working variables
-            uint64_t a = H[0], b = H[1], c = H[2], d = H[3],
-                     e = H[4], f = H[5], g = H[6], h = H[7];
-
-            // Main compression loop
-            for (int t = 0; t < 80; ++t) {
+        for (int base = 0; base < 80; base += 16) {
+#pragma GCC unroll 16
+            for (int j = 0; j < 16; ++j) {
+                if (base > 0) {
+                    W[j] += smallSigma1_64(W[(j + 14) & 15]) + W[(j + 9) & 15] + smallSigma0_64(W[(j + 1) & 15]);
+                }
                 uint64_t S1 = sigma1_64(e);
                 uint64_t ch = (e & f) ^ (~e & g);
-                uint64_t temp1 = h + S1 + ch + SHA512_K[t] + W[t];
+                uint64_t temp1 = h + S1 + ch + SHA512_K[base + j] + W[j];
                 uint64_t S0 = sigma0_64(a);
                 uint64_t maj = (a & b) ^ (a & c) ^ (b & c);
                 uint64_t temp2 = S0 + maj;
@@ -121,89 +95,148 @@ public:
                 b = a;
                 a = temp1 + temp2;
             }
+        }
 
-            // Update hash values
-            H[0] += a; H[1] += b; H[2] += c; H[3] += d;
-            H[4] += e; H[5] += f; H[6] += g; H[7] += h;
+        // Update hash values
+        H[0] += a; H[1] += b; H[2] += c; H[3] += d;
+        H[4] += e; H[5] += f; H[6] += g; H[7] += h;
+    }
+
+    // One MD5 compression over a 64-byte block
+    static void md5Block(uint32_t state[4], const uint8_t* block) {
+        uint32_t a = state[0], b = state[1], c = state[2], d = state[3];
+
+        // Break the block into sixteen 32-bit little-endian words once
+        uint32_t M[16];
+        for (int k = 0; k < 16; ++k) {
+            M[k] = (uint32_t)block[k*4] |
+                   ((uint32_t)block[k*4 + 1] << 8) |
+                   ((uint32_t)block[k*4 + 2] << 16) |
+                   ((uint32_t)block[k*4 + 3] << 24);
         }
 
-        // Generate final hash
-        std::stringstream ss;
-        for (int i = 0; i < 8; ++i) {
-            ss << std::hex << std::setw(16) << std::setfill('0') << H[i];
+        // Main loop
+        for (int j = 0; j < 64; ++j) {
+            uint32_t f, g;
+            if (j < 16) {
+                f = (b & c) | (~b & d);
+                g = j;
+            } else if (j < 32) {
+                f = (d & b) | (~d & c);
+                g = (5 * j + 1) % 16;
+            } else if (j < 48) {
+                f = b ^ c ^ d;
+                g = (3 * j + 5) % 16;
+            } else {
+                f = c ^ (b | ~d);
+                g = (7 * j) % 16;
+            }
+
+            uint32_t word = M[g];
+
+            uint32_t temp = d;
+            d = c;
+            c = b;
+            b = b + ((a + f + MD5_K[j] + word) << MD5_S[j] | 
+                     (a + f + MD5_K[j] + word) >> (32 - MD5_S[j]));
+            a = temp;
         }
-        return ss.str();
+
+        // Update hash values
+        state[0] += a; state[1] += b; state[2] += c; state[3] += d;
     }
 
-    // MD5 Implementation
-    static std::string md5(const std::string& input) {
+    // SHA-512 constants
+    static const uint64_t SHA512_K[80];
+
+    // MD5 constants
+    static const uint32_t MD5_K[64];
+    static const uint32_t MD5_S[64];
+
+public:
+    static const size_t SHA512_DIGEST_SIZE = 64;
+    static const size_t MD5_DIGEST_SIZE = 16;
+
+    // SHA-512 Implementation
+    // Hashes straight from caller memory into a caller buffer without
+    // allocating; the message schedule is a rolling 16-word window
+    static void sha512(const uint8_t* data, size_t length, uint8_t digest[SHA512_DIGEST_SIZE]) {
         // Initial hash values
-        uint32_t a0 = 0x67452301;
-        uint32_t b0 = 0xefcdab89;
-        uint32_t c0 = 0x98badcfe;
-        uint32_t d0 = 0x10325476;
-
-        // Preprocessing
-        std::vector<uint8_t> message(input.begin(), input.end());
-        uint64_t ml = message.size() * 8;
-        message.push_back(0x80);
-
-        // Padding
-        while ((message.size() * 8 + 64) % 512 != 0) {
-            message.push_back(0);
+        uint64_t H[8] = {
+            0x6a09e667f3bcc908ULL, 0xbb67ae8584caa73bULL,
+            0x3c6ef372fe94f82bULL, 0xa54ff53a5f1d36f1ULL,
+            0x510e527fade682d1ULL, 0x9b05688c2b3e6c1fULL,
+            0x1f83d9abfb41bd6bULL, 0x5be0cd19137e2179ULL
+        };
+
+        // Process whole 1024-bit blocks in place
+        size_t full = length / 128;
+        for (size_t i = 0; i < full; ++i) {
+            sha512Block(H, data + i * 128);
         }
 
-        // Append message length (little-endian)
+        // Padding: 0x80, zeros, then the 128-bit big-endian bit length;
+        // one extra block when the tail leaves no room for the length
+        uint8_t tail[256] = {0};
+        size_t rest = length % 128;
+        std::copy(data + full * 128, data + length, tail);
+        tail[rest] = 0x80;
+        size_t tailLength = rest < 112 ? 128 : 256;
+        uint64_t bitsHigh = (uint64_t)length >> 61, bitsLow = (uint64_t)length << 3;
         for (int i = 0; i < 8; ++i) {
-            message.push_back((ml >> (i * 8)) & 0xFF);
+            tail[tailLength - 16 + i] = (uint8_t)(bitsHigh >> (56 - i * 8));
+            tail[tailLength - 8 + i] = (uint8_t)(bitsLow >> (56 - i * 8));
+        }
+        for (size_t i = 0; i < tailLength; i += 128) {
+            sha512Block(H, tail + i);
         }
 
-        // Process message in 512-bit blocks
-        for (size_t i = 0; i < message.size(); i += 64) {
-            uint32_t a = a0, b = b0, c = c0, d = d0;
-
-            // Main loop
-            for (int j = 0; j < 64; ++j) {
-                uint32_t f, g;
-                if (j < 16) {
-                    f = (b & c) | (~b & d);
-                    g = j;
-                } else if (j < 32) {
-                    f = (d & b) | (~d & c);
-                    g = (5 * j + 1) % 16;
-                } else if (j < 48) {
-                    f = b ^ c ^ d;
-                    g = (3 * j + 5) % 16;
-                } else {
-                    f = c ^ (b | ~d);
-                    g = (7 * j) % 16;
-                }
+        // Big-endian digest words
+        for (int i = 0; i < 64; ++i) {
+            digest[i] = (uint8_t)(H[i / 8] >> (56 - (i % 8) * 8));
+        }
+    }
 
-                // Extract 32-bit word from message
-                uint32_t word = 0;
-                for (int k = 0; k < 4; ++k) {
-                    word |= (uint32_t)message[i + g*4 + k] << (k * 8);
-                }
+    static std::string sha512(const std::string& input) {
+        uint8_t digest[SHA512_DIGEST_SIZE];
+        sha512(reinterpret_cast<const uint8_t*>(input.data()), input.size(), digest);
+        return hexEncode(digest, SHA512_DIGEST_SIZE);
+    }
 
-                uint32_t temp = d;
-                d = c;
-                c = b;
-                b = b + ((a + f + MD5_K[j] + word) << MD5_S[j] | 
-                         (a + f + MD5_K[j] + word) >> (32 - MD5_S[j]));
-                a = temp;
-            }
+    // MD5 Implementation (same shape: caller memory in, caller buffer out)
+    static void md5(const uint8_t* data, size_t length, uint8_t digest[MD5_DIGEST_SIZE]) {
+        // Initial hash values
+        uint32_t state[4] = { 0x67452301, 0xefcdab89, 0x98badcfe, 0x10325476 };
 
-            // Update hash values
-            a0 += a; b0 += b; c0 += c; d0 += d;
+        size_t full = length / 64;
+        for (size_t i = 0; i < full; ++i) {
+            md5Block(state, data + i * 64);
         }
 
-        // Generate final hash
-        std::stringstream ss;
-        ss << std::hex << std::setw(8) << std::setfill('0') << a0
-           << std::setw(8) << std::setfill('0') << b0
-           << std::setw(8) << std::setfill('0') << c0
-           << std::setw(8) << std::setfill('0') << d0;
-        return ss.str();
+        // Padding: 0x80, zeros, then the 64-bit little-endian bit length
+        uint8_t tail[128] = {0};
+        size_t rest = length % 64;
+        std::copy(data + full * 64, data + length, tail);
+        tail[rest] = 0x80;
+        size_t tailLength = rest < 56 ? 64 : 128;
+        uint64_t ml = (uint64_t)length << 3;
+        for (int i = 0; i < 8; ++i) {
+            tail[tailLength - 8 + i] = (uint8_t)(ml >> (i * 8));
+        }
+        for (size_t i = 0; i < tailLength; i += 64) {
+            md5Block(state, tail + i);
+        }
+
+        // MD5 emits its state words little-endian
+        for (int i = 0; i < 16; ++i) {
+            digest[i] = (uint8_t)(state[i / 4] >> ((i % 4) * 8));
+        }
+    }
+
+    static std::string md5(const std::string& input) {
+        uint8_t digest[MD5_DIGEST_SIZE];
+        md5(reinterpret_cast<const uint8_t*>(input.data()), input.size(), digest);
+        return hexEncode(digest, MD5_DIGEST_SIZE);
     }
 
     // Digital Signature Simulation (simplified ElGamal-like approach)